@@ -105,6 +105,8 @@ void loop() {
     switch (msg.messageType) {
       case MessageDocument :
         {
+          // The link to the file is requested only when needed
+          myBot.getFile(msg.document);
           document = msg.document.file_path;
           if (msg.document.file_exists) {
 
@@ -29,7 +29,8 @@ bool updateHandler(TBMessage &theMsg, AsyncTelegram2 &theBot) {
     // The massage received if "document" type (binary file)
     case MessageDocument: {
 
-        // Store in memory link to the firmware file
+        // Request and store in memory link to the firmware file
+        theBot.getFile(theMsg.document);
         fw_path = theMsg.document.file_path;
         if (theMsg.document.file_exists) {
 
@@ -1,14 +1,146 @@
 #include "AsyncTelegram2.h"
 #include "serial_log.h"
-
-#define HEADERS_END "\r\n\r\n"
+#include <new>
 
 void AsyncTelegram2::initClient(Client &client, uint32_t bufferSize)
 {
     m_botusername.reserve(32); // Telegram username is 5-32 chars lenght
     m_rxbuffer.reserve(bufferSize);
     this->telegramClient = &client;
+    m_main.setClient(&client);
     m_minUpdateTime = MIN_UPDATE_TIME;
+#if !TELEGRAM_SAX_PARSER
+    initUpdateFilter();
+#endif
+}
+
+#if !TELEGRAM_SAX_PARSER
+// Fields of an update used to fill TBMessage (path is relative to the update object)
+static const char *const updateFilterFields[] = {
+    "update_id",
+    "callback_query/id",
+    "callback_query/from/id",
+    "callback_query/from/username",
+    "callback_query/from/first_name",
+    "callback_query/from/last_name",
+    "callback_query/message/chat/id",
+    "callback_query/message/message_id",
+    "callback_query/message/date",
+    "callback_query/message/text",
+    "callback_query/chat_instance",
+    "callback_query/data",
+    "channel_post/sender_chat/id",
+    "channel_post/sender_chat/title",
+    "channel_post/chat/id",
+    "channel_post/text",
+    "message/message_id",
+    "message/from/id",
+    "message/from/username",
+    "message/from/first_name",
+    "message/from/last_name",
+    "message/chat/id",
+    "message/date",
+    "message/text",
+    "message/caption",
+    "message/location/longitude",
+    "message/location/latitude",
+    "message/contact/user_id",
+    "message/contact/first_name",
+    "message/contact/last_name",
+    "message/contact/phone_number",
+    "message/contact/vcard",
+    "message/new_chat_member/is_bot",
+    "message/new_chat_member/id",
+    "message/new_chat_member/first_name",
+    "message/new_chat_member/last_name",
+    "message/new_chat_member/username",
+    "message/left_chat_member/is_bot",
+    "message/left_chat_member/id",
+    "message/left_chat_member/first_name",
+    "message/left_chat_member/last_name",
+    "message/left_chat_member/username",
+    "message/document/file_id",
+    "message/document/file_name",
+    "message/document/file_size",
+    "message/reply_to_message/message_id"
+};
+
+// Add path (relative to the update object) to filter
+static bool addFilterPath(JsonDocument &filter, const char *path)
+{
+    JsonObject node = filter["result"][0];
+    char key[33];
+    for (const char *sep = strchr(path, '/'); sep != nullptr; sep = strchr(path, '/'))
+    {
+        size_t len = sep - path;
+        if (len == 0 || len >= sizeof(key))
+            return false;
+        memcpy(key, path, len);
+        key[len] = '\0';
+        path = sep + 1;
+
+        // The whole object is already kept
+        if (node[key].is<bool>())
+            return true;
+#if ARDUINOJSON_VERSION_MAJOR > 6
+        node = node[key].is<JsonObject>() ? node[key].as<JsonObject>() : node[key].to<JsonObject>();
+#else
+        node = node[key].is<JsonObject>() ? node[key].as<JsonObject>() : node.createNestedObject(key);
+#endif
+    }
+
+    if (strlen(path) == 0 || strlen(path) >= sizeof(key))
+        return false;
+    strcpy(key, path);
+    node[key] = true;
+    return !filter.overflowed();
+}
+
+void AsyncTelegram2::initUpdateFilter()
+{
+#if ARDUINOJSON_VERSION_MAJOR > 6
+    m_updateFilter.clear();
+    m_updateFilter["ok"] = true;
+    m_updateFilter["error_code"] = true;
+    m_updateFilter["description"] = true;
+    m_updateFilter["parameters"] = true;
+    m_updateFilter["result"].add<JsonObject>();
+    for (const char *path : updateFilterFields)
+        addFilterPath(m_updateFilter, path);
+#else
+    // Built in a large pool, then kept in one as big as the fields need
+    DynamicJsonDocument filter(BUFFER_BIG);
+    filter["ok"] = true;
+    filter["error_code"] = true;
+    filter["description"] = true;
+    filter["parameters"] = true;
+    filter.createNestedArray("result").createNestedObject();
+    for (const char *path : updateFilterFields)
+        addFilterPath(filter, path);
+    filter.shrinkToFit();
+    m_updateFilter = filter;
+#endif
+}
+#endif
+
+bool AsyncTelegram2::addUpdateFilter(const char *path)
+{
+#if TELEGRAM_SAX_PARSER
+    // UpdateParser decodes only the fields of TBMessage
+    (void)path;
+    return false;
+#elif ARDUINOJSON_VERSION_MAJOR > 6
+    return addFilterPath(m_updateFilter, path);
+#else
+    // Pool is as big as the fields already in the filter: copy them in a larger one
+    DynamicJsonDocument filter(m_updateFilter.memoryUsage() + JSON_OBJECT_SIZE(8) + 2 * strlen(path) + 16);
+    filter.set(m_updateFilter);
+    if (!addFilterPath(filter, path))
+        return false;
+    filter.shrinkToFit();
+    m_updateFilter = filter;
+    return true;
+#endif
 }
 
 AsyncTelegram2::AsyncTelegram2(Client &client, uint32_t bufferSize)
@@ -21,15 +153,82 @@ AsyncTelegram2::AsyncTelegram2(TelegramSecureClient &client, uint32_t bufferSize
 {
     initClient(client, bufferSize);
     secureTelegramClient = &client;
+#if defined(ESP8266)
+    // Reconnections resume the last TLS session (abbreviated handshake)
+    client.setSession(m_bearSSLSession.session());
+    m_tlsSession = &m_bearSSLSession;
+#endif
 }
 #endif
 
-AsyncTelegram2::~AsyncTelegram2(){};
+AsyncTelegram2::~AsyncTelegram2()
+{
+    // Dedicated connections (the same one can be shared by more traffic classes)
+    for (uint8_t i = TrafficCommands; i < TrafficClassCount; i++)
+    {
+        if (m_connections[i] == &m_main)
+            continue;
+        TelegramConnection *conn = m_connections[i];
+        for (uint8_t j = i; j < TrafficClassCount; j++)
+        {
+            if (m_connections[j] == conn)
+                m_connections[j] = &m_main;
+        }
+        delete conn;
+    }
+}
 
-bool AsyncTelegram2::connectToTelegramServer()
+bool AsyncTelegram2::setTrafficClient(TrafficClass traffic, Client &client)
 {
-    if (telegramClient->connect(TELEGRAM_HOST, TELEGRAM_PORT))
+    if (traffic != TrafficCommands && traffic != TrafficUploads)
+        return false;
+
+    TelegramConnection *previous = m_connections[traffic];
+    if (previous->client == &client)
+        return true;
+
+    // Client already used by another class of requests
+    TelegramConnection *conn = nullptr;
+    for (uint8_t i = 0; i < TrafficClassCount && conn == nullptr; i++)
+    {
+        if (m_connections[i]->client == &client)
+            conn = m_connections[i];
+    }
+    if (conn == nullptr)
+    {
+        conn = new (std::nothrow) TelegramConnection();
+        if (conn == nullptr)
+            return false;
+        conn->setClient(&client);
+    }
+    m_connections[traffic] = conn;
+
+    // The dedicated connection replaced is deleted, unless another class still uses it
+    if (previous == &m_main)
+        return true;
+    for (uint8_t i = 0; i < TrafficClassCount; i++)
     {
+        if (m_connections[i] == previous)
+            return true;
+    }
+    if (m_uploadConn == previous)
+        cancelUpload();
+    previous->stop();
+    reportLost(*previous);
+    delete previous;
+    return true;
+}
+
+bool AsyncTelegram2::connectToTelegramServer(Client &client)
+{
+    // Connection mode refers to the main client
+    bool mainClient = &client == telegramClient;
+    if (connectClient(client))
+    {
+        if (!mainClient)
+        {
+            return true;
+        }
         if (m_insecureMode)
         {
             m_connectionMode = ConnectionModeInsecureFallback;
@@ -48,24 +247,27 @@ bool AsyncTelegram2::connectToTelegramServer()
     if (m_connectionRecoveryCallback != nullptr)
     {
         log_error("Telegram connection failed, invoking custom recovery callback");
-        telegramClient->stop();
-        if (m_connectionRecoveryCallback(*telegramClient, TELEGRAM_HOST, TELEGRAM_PORT))
+        client.stop();
+        if (m_connectionRecoveryCallback(client, m_host, m_port))
         {
-            if (telegramClient->connect(TELEGRAM_HOST, TELEGRAM_PORT))
+            if (connectClient(client))
             {
-                m_customRecoveryMode = true;
-                m_connectionMode = ConnectionModeCustomRecovery;
+                if (mainClient)
+                {
+                    m_customRecoveryMode = true;
+                    m_connectionMode = ConnectionModeCustomRecovery;
+                }
                 return true;
             }
         }
     }
 
 #if defined(ESP32) || defined(ESP8266)
-    if (m_insecureFallbackEnabled && !m_insecureMode && enableInsecureMode())
+    if (mainClient && m_insecureFallbackEnabled && !m_insecureMode && enableInsecureMode())
     {
         log_error("TLS certificate validation failed, retrying with insecure client");
         telegramClient->stop();
-        if (telegramClient->connect(TELEGRAM_HOST, TELEGRAM_PORT))
+        if (connectClient(*telegramClient))
         {
             m_insecureMode = true;
             m_customRecoveryMode = false;
@@ -78,6 +280,46 @@ bool AsyncTelegram2::connectToTelegramServer()
     return false;
 }
 
+// Open the connection, measuring the time taken by the TLS handshake
+bool AsyncTelegram2::connectClient(Client &client)
+{
+    // Only the main client uses m_tlsSession
+    TLSSession *session = &client == telegramClient ? m_tlsSession : nullptr;
+    if (session != nullptr && m_sessionCache != nullptr && !m_sessionLoaded)
+    {
+        m_sessionLoaded = true;
+        m_sessionCache->load(session->data(), session->size());
+    }
+    bool resuming = session != nullptr && session->offer(client);
+
+    uint32_t start = millis();
+    bool connected = client.connect(m_host, m_port);
+    uint32_t time = millis() - start;
+    if (!connected)
+    {
+        m_handshakeStats.failed++;
+        return false;
+    }
+    m_handshakeStats.handshakes++;
+    m_handshakeStats.lastTime = time;
+    m_handshakeStats.totalTime += time;
+
+    if (session != nullptr)
+    {
+        if (session->resumed(client) && resuming)
+        {
+            m_handshakeStats.resumed++;
+            m_handshakeStats.resumedTime += time;
+        }
+        else if (m_sessionCache != nullptr)
+        {
+            m_sessionCache->save(session->data(), session->size());
+        }
+    }
+    log_debug("TLS handshake: %d ms", (int)time);
+    return true;
+}
+
 #if defined(ESP32) || defined(ESP8266)
 bool AsyncTelegram2::enableInsecureMode()
 {
@@ -92,12 +334,19 @@ bool AsyncTelegram2::enableInsecureMode()
 #endif
 
 bool AsyncTelegram2::checkConnection()
+{
+    return checkConnection(m_main);
+}
+
+bool AsyncTelegram2::checkConnection(TelegramConnection &conn)
 {
     // Start connection with Telegramn server (if necessary)
-    if (!telegramClient->connected())
+    if (!conn.client->connected())
     {
 
-        m_lastmsg_timestamp = millis();
+        if (&conn == &m_main)
+            m_lastmsg_timestamp = millis();
+        conn.clear();
         log_info("Start handshaking...");
 
         // ESP8266 Soft watch dog reset issue
@@ -105,10 +354,11 @@ bool AsyncTelegram2::checkConnection()
         ESP.wdtDisable();
         *((volatile uint32_t*) 0x60000900) &= ~(1); // Hardware WDT OFF
         #endif
-        if (!connectToTelegramServer())
+        if (!connectToTelegramServer(*conn.client))
         {
             Serial.println("\n\nUnable to connect to Telegram server");
-            reset();
+            if (&conn == &m_main)
+                reset();
         }
 #if DEBUG_ENABLE
         else
@@ -135,7 +385,7 @@ bool AsyncTelegram2::checkConnection()
     *((volatile uint32_t*) 0x60000900) |= 1; // Hardware WDT ON
     #endif
 
-    return telegramClient->connected();
+    return conn.client->connected();
 }
 
 bool AsyncTelegram2::begin()
@@ -150,181 +400,749 @@ bool AsyncTelegram2::reset(void)
     if (millis() - lastResetTime > 5000) {
         lastResetTime = millis();
         log_info("Restart Telegram connection\n");
-        telegramClient->stop();
+        m_main.stop();
         m_lastmsg_timestamp = millis();
-        m_waitingReply = false;
     }
     return telegramClient->connected();
 }
 
+// A pending long polling request would delay the reply to any other request sent
+// on the same connection until server timeout expires: long polling is used only
+// when commands and uploads have a connection of their own
+uint16_t AsyncTelegram2::longPollTimeout() const
+{
+    if (m_connections[TrafficCommands] == &m_main || m_connections[TrafficUploads] == &m_main)
+        return 0;
+    return m_longPollTimeout;
+}
+
+// Result of a reply: HTTP status and Retry-After from headers, then fields of JSON body
+static void parseResult(TelegramConnection::RequestKind kind, const HttpResponse &response, const char *reply, TBResult &result)
+{
+    result.httpStatus = response.status();
+    result.retryAfter = response.retryAfter();
+    result.ok = strstr(reply, "\"ok\":true") != nullptr;
+    if (result.ok)
+    {
+        // Message sent or edited ("message_id" is the first field of Message)
+        const char *value = kind == TelegramConnection::RequestCommand ? strstr(reply, "\"result\":{\"message_id\":") : nullptr;
+        if (value != nullptr)
+            result.messageId = atol(value + strlen("\"result\":{\"message_id\":"));
+        return;
+    }
+
+    const char *value = strstr(reply, "\"error_code\":");
+    if (value != nullptr)
+        result.errorCode = atol(value + strlen("\"error_code\":"));
+    value = strstr(reply, "\"retry_after\":");
+    if (value != nullptr)
+        result.retryAfter = strtoul(value + strlen("\"retry_after\":"), nullptr, 10);
+    value = strstr(reply, "\"description\":\"");
+    if (value != nullptr)
+    {
+        // Escaped chars are kept as they are
+        for (value += strlen("\"description\":\""); *value && !(*value == '"' && value[-1] != '\\'); value++)
+            result.description += *value;
+    }
+}
+
+// Read the oldest pending reply and discard it (blocking).
+// Updates of a skipped polling reply are not confirmed, so they will be received again
+void AsyncTelegram2::skipReply(TelegramConnection &conn)
+{
+    if (!waitResponse(conn))
+    {
+        log_error("Invalid HTTP response");
+        conn.stop();
+        return;
+    }
+    TelegramConnection::Request request = conn.pop();
+    TBResult result;
+    parseResult(request.kind, conn.response, replyBuffer(conn).c_str(), result);
+    endResponse(conn);
+    endRequest(request, result);
+}
+
+// Read the replies received on a dedicated connection (it doesn't wait)
+void AsyncTelegram2::readReplies(TelegramConnection &conn)
+{
+    while (conn.pending() && conn.client->connected() && conn.rx.available())
+    {
+        if (!readHeaders(conn))
+        {
+            log_error("Invalid HTTP response");
+            conn.stop();
+            return;
+        }
+        if (!conn.response.headersDone() || !readBody(conn))
+            return;
+
+        TelegramConnection::Request request = conn.pop();
+        TBResult result;
+        parseResult(request.kind, conn.response, conn.reply.c_str(), result);
+        endResponse(conn);
+        endRequest(request, result);
+    }
+    conn.checkClosed();
+    reportLost(conn);
+}
+
+// Report the failure of the requests whose reply was lost when conn was closed
+void AsyncTelegram2::reportLost(TelegramConnection &conn, const char *description)
+{
+    uint32_t id;
+    while ((id = conn.takeLost()) != 0)
+        failRequest(id, description);
+}
+
+void AsyncTelegram2::failRequest(uint32_t id, const char *description)
+{
+    TBResult result;
+    result.description = description;
+    endRequest(TelegramConnection::Request{TelegramConnection::RequestCommand, id}, result);
+}
+
+// Id of a new request (polling requests have none)
+uint32_t AsyncTelegram2::newRequestId()
+{
+    if (++m_requestId == 0)
+        m_requestId = 1;
+    m_lastRequestId = m_requestId;
+    // Sent callback waits for the first request after sendMessage() was called
+    if (m_waitSent && m_sentRequestId == 0)
+        m_sentRequestId = m_requestId;
+    return m_requestId;
+}
+
 bool AsyncTelegram2::sendCommand(const char *command, const char *payload, bool blocking)
 {
-    if (checkConnection())
-    {
-        String httpBuffer((char *)0);
-        httpBuffer.reserve(BUFFER_BIG);
-        httpBuffer = "POST https://" TELEGRAM_HOST "/bot";
-        httpBuffer += m_token;
-        httpBuffer += "/";
-        httpBuffer += command;
-        // Let's use 1.0 protocol in order to avoid chunked transfer encoding
-        httpBuffer += " HTTP/1.0"
-                      "\nHost: " TELEGRAM_HOST
-                      "\nConnection: keep-alive"
-                      "\nContent-Type: application/json";
-        httpBuffer += "\nContent-Length: ";
-        httpBuffer += strlen(payload);
-        httpBuffer += "\n\n";
-        httpBuffer += payload;
+    return sendPayload(command, payload, JsonVariantConst(), blocking);
+}
+
+bool AsyncTelegram2::sendCommand(const char *command, const JsonDocument &payload, bool blocking)
+{
+    return sendPayload(command, nullptr, payload, blocking);
+}
+
+bool AsyncTelegram2::sendPayload(const char *command, const char *text, JsonVariantConst json, bool blocking)
+{
+    bool poll = strcmp(command, "getUpdates") == 0;
+    uint32_t id = poll ? 0 : newRequestId();
+
+    // Messages are sent later by the queue, at the rate allowed by Telegram
+    if (m_sendQueue != nullptr && !blocking && !poll)
+    {
+        // The queue keeps its own copy of the payload
+        String payload;
+        if (text == nullptr)
+            serializeJson(json, payload);
+        if (m_sendQueue->push(command, text != nullptr ? text : payload.c_str(), id))
+            return true;
+        log_error("Send queue is full");
+        m_lastRequestId = 0;
+        return false;
+    }
+
+    // Telegram would refuse the message anyway, and wait longer next time
+    if (!blocking && !poll && m_floodDelay && millis() - m_floodTime < m_floodDelay)
+    {
+        log_error("Too many requests, retry later");
+        m_lastRequestId = 0;
+        return false;
+    }
+    return sendRequest(command, text, json, blocking, id);
+}
+
+// Send the queued messages allowed by rate limits (only if they can be pipelined)
+void AsyncTelegram2::sendQueued()
+{
+    // Messages would wait for the end of the upload
+    if (m_upload.active() && (m_uploadConn == &m_main || m_uploadConn == m_connections[TrafficCommands]))
+        return;
+
+    // Without reply for too long: a late reply couldn't be matched, so its connection is closed
+    uint32_t id;
+    while ((id = m_sendQueue->expired(millis())) != 0)
+    {
+        TelegramConnection *conn = m_connections[TrafficCommands]->waiting(id) ? m_connections[TrafficCommands] :
+                                   m_main.waiting(id) ? &m_main : nullptr;
+        if (conn == nullptr)
+        {
+            failRequest(id, "Reply timeout");
+            continue;
+        }
+        conn->stop();
+        reportLost(*conn, "Reply timeout");
+    }
+
+    int8_t index;
+    while (!m_main.full() && !m_connections[TrafficCommands]->full() && (index = m_sendQueue->next(millis())) >= 0)
+    {
+        // Sent callback timeout starts now
+        if (m_waitSent)
+            m_lastSentTime = millis();
+        // Kept in the queue until the reply is received (it may be sent again)
+        if (writeRequest(m_sendQueue->command(index), m_sendQueue->payload(index), JsonVariantConst(), m_sendQueue->id(index)) == nullptr)
+            return;
+        m_sendQueue->sent(index, millis());
+    }
+}
+
+bool AsyncTelegram2::sendRequest(const char *command, const char *text, JsonVariantConst json, bool blocking, uint32_t id)
+{
+    TelegramConnection *request = writeRequest(command, text, json, id);
+    if (request == nullptr || !blocking)
+        return false;
+    TelegramConnection &conn = *request;
+
+    // Replies to the requests sent before this one come first
+    while (conn.pending() > 1)
+        skipReply(conn);
+
+    // Wait the whole response (with timeout)
+    if (conn.pending() == 0 || !waitResponse(conn))
+    {
+        log_error("Invalid HTTP response");
+        conn.stop();
+        reportLost(conn);
+        return false;
+    }
+    TelegramConnection::Request sent = conn.pop();
+    TBResult result;
+    parseResult(sent.kind, conn.response, replyBuffer(conn).c_str(), result);
+    endResponse(conn);
+    endRequest(sent, result);
+    return result.ok;
+}
+
+// Send a request on the connection of its class
+// returns: the connection where the reply will be received (nullptr if not sent)
+TelegramConnection *AsyncTelegram2::writeRequest(const char *command, const char *text, JsonVariantConst json, uint32_t id)
+{
+    // The reply to forwardMessage is decoded like the updates
+    bool poll = strcmp(command, "getUpdates") == 0;
+    bool updates = poll || strcmp(command, "forwardMessage") == 0;
+    TelegramConnection &conn = *m_connections[updates ? TrafficUpdates : TrafficCommands];
+    reportLost(conn);
 
+    // The request can't be written in the middle of the upload
+    if (m_upload.active() && m_uploadConn == &conn)
+        finishUpload();
+
+    // Without room for one more request, the oldest reply is read first
+    if (conn.full())
+        skipReply(conn);
+
+    if (checkConnection(conn))
+    {
         #if DEBUG_ENABLE
-        if (strcmp(command, "getUpdates") != 0) {
-            log_debug("Command %s, payload: %s\n", command, payload);
+        if (!poll) {
+            String payload;
+            if (text == nullptr)
+                serializeJson(json, payload);
+            log_debug("Command %s, payload: %s\n", command, text != nullptr ? text : payload.c_str());
         }
         #endif
 
-        // Send the whole request in one go is much faster
-        telegramClient->print(httpBuffer);
-
-        m_waitingReply = true;
-        // Blocking mode
-        if (blocking)
+        // The document is serialized straight to the client (its length is measured
+        // first): the buffer of the writer is the only copy of the request in memory,
+        // and the request still reaches the client in a few large writes
+        RequestWriter writer(*conn.client);
+        writer.print(m_requestPrefix);
+        writer.print(command);
+        // Persistent connection: chunked replies are decoded by conn.body
+        writer.print(" HTTP/1.1\r\nHost: ");
+        writer.print(m_host);
+        writer.print("\r\nConnection: keep-alive"
+                     "\r\nContent-Type: application/json"
+                     "\r\nContent-Length: ");
+        writer.print(text != nullptr ? strlen(text) : measureJson(json));
+        writer.print("\r\n\r\n");
+        if (text != nullptr)
+            writer.print(text);
+        else
+            serializeJson(json, writer);
+        if (!writer.end())
         {
-            // Wait data (with timeout)
-            uint32_t timeout = millis() + 1000;
-            while (!telegramClient->available() && millis() < timeout) ;
+            log_error("Request not sent");
+            conn.stop();
+            return nullptr;
+        }
 
-            // Skip headers
-            if (!telegramClient->find((char *)HEADERS_END))
-            {
-                log_error("Invalid HTTP response");
-                telegramClient->stop();
-                return false;
-            }
+        conn.push(poll ? TelegramConnection::RequestPoll : TelegramConnection::RequestCommand, id);
+        return &conn;
+    }
 
-            // If there are incoming bytes available from the server, read them and print them:
-            m_rxbuffer = "";
-            while (telegramClient->available())
-            {
-                yield();
-                m_rxbuffer += (char)telegramClient->read();
-            }
+    return nullptr;
+}
 
-            m_waitingReply = false;
-            if (m_rxbuffer.indexOf("\"ok\":true") > -1)
-                return true;
-        }
+// Record the result of a reply (successful polling is not), apply flood control
+// and report the completion of the request
+void AsyncTelegram2::endRequest(const TelegramConnection::Request &request, const TBResult &result)
+{
+    if (request.kind == TelegramConnection::RequestPoll)
+    {
+        pollResult(result.ok, result.retryAfter);
+        if (result.ok)
+            return;
     }
+    m_result = result;
+    m_result.requestId = request.id;
 
-    return false;
+    // Only sending is paused: a throttled poll is delayed by pollResult()
+    bool flood = request.kind != TelegramConnection::RequestPoll && (result.httpStatus == 429 || result.errorCode == 429);
+    if (!result.ok) {
+        log_debug("HTTP status %u, error %ld: %s\n", result.httpStatus, (long)result.errorCode, result.description.c_str());
+    }
+    if (flood)
+    {
+        // Without retry_after wait at least one second
+        m_floodTime = millis();
+        m_floodDelay = (result.retryAfter ? result.retryAfter : 1) * 1000UL;
+        log_info("Too many requests, sending paused");
+    }
+
+    if (m_sendQueue != nullptr)
+    {
+        if (flood)
+            m_sendQueue->pause(m_floodTime, m_floodDelay);
+        // A throttled message is kept in the queue: it's not completed yet
+        if (flood && m_sendQueue->retry(request.id))
+            return;
+        m_sendQueue->done(request.id);
+    }
+
+    // Polling requests are not reported
+    if (request.id == 0)
+        return;
+
+    // Server replied before the whole upload was written (i.e. file too large)
+    if (m_upload.active() && request.id == m_uploadId)
+    {
+        m_upload.end();
+        m_uploadConn->stop();
+        m_uploadConn = nullptr;
+    }
+    if (m_waitSent && request.id == m_sentRequestId && m_sentCallback != nullptr)
+    {
+        m_waitSent = false;
+        m_sentCallback(result.ok);
+    }
+    if (m_completionCallback != nullptr)
+        m_completionCallback(m_result);
+}
+
+// Errors replied at once (i.e. 409 Conflict, 401 Unauthorized) and failed connections
+// delay the next poll, so getUpdates is not sent again on each loop
+void AsyncTelegram2::pollResult(bool ok, uint32_t retryAfter)
+{
+    if (ok)
+    {
+        m_pollBackoff = 0;
+        return;
+    }
+    m_pollBackoff = m_pollBackoff ? m_pollBackoff * 2 : m_minUpdateTime;
+    if (m_pollBackoff > MAX_POLL_BACKOFF)
+        m_pollBackoff = MAX_POLL_BACKOFF;
+    if (retryAfter * 1000UL > m_pollBackoff)
+        m_pollBackoff = retryAfter * 1000UL;
 }
 
 bool AsyncTelegram2::getUpdates()
 {
+    if (m_upload.active())
+        runUpload();
+    if (m_sendQueue != nullptr)
+        sendQueued();
+
+    // Replies on dedicated connections are read without waiting updates
+    for (uint8_t i = TrafficCommands; i < TrafficClassCount; i++)
+    {
+        if (m_connections[i] != &m_main && m_connections[i] != m_connections[i - 1])
+            readReplies(*m_connections[i]);
+    }
+    m_main.checkClosed();
+    reportLost(m_main);
 
-    // No response from Telegram server for a long time
-    if (millis() - m_lastmsg_timestamp > 10 * m_minUpdateTime)
+    // No response from Telegram server for a long time (not expected while uploading)
+    uint16_t longPoll = longPollTimeout();
+    if (m_upload.active() && m_uploadConn == &m_main)
+        m_lastmsg_timestamp = millis();
+    else if (longPoll)
+    {
+        // Server can hold the long polling request up to the requested timeout
+        if (m_main.pending() && millis() - m_lastUpdateTime > longPoll * 1000UL + SERVER_TIMEOUT)
+        {
+            log_error("Long polling request expired");
+            reset();
+        }
+    }
+    else if (m_main.pending() && millis() - m_lastmsg_timestamp > 10 * m_minUpdateTime)
     {
         reset();
     }
 
     // Send message to Telegram server only if enough time has passed since last
-    if (millis() - m_lastUpdateTime > m_minUpdateTime)
+    // (with long polling as soon as previous reply was received, unless it failed)
+    uint32_t pollDelay = longPoll ? 0 : m_minUpdateTime;
+    if (m_pollBackoff > pollDelay)
+        pollDelay = m_pollBackoff;
+    if (pollDelay == 0 || millis() - m_lastUpdateTime > pollDelay)
     {
-        m_lastUpdateTime = millis();
-
-        // If previuos reply from server was received (and parsed)
-        if (m_waitingReply == false)
+        // If previuos replies from server were received (and parsed)
+        if (m_main.pending() == 0)
         {
+            m_lastUpdateTime = millis();
             char payload[BUFFER_SMALL];
-            snprintf(payload, BUFFER_SMALL, "{\"limit\":1,\"timeout\":0,\"offset\":%" PRIu32 "}", m_lastUpdateId);
+            size_t len = snprintf(payload, BUFFER_SMALL, "{\"limit\":%u,\"timeout\":%u,\"offset\":%" PRIu32,
+                                  m_updatesLimit, longPoll, m_lastUpdateId);
+            // Server will remember the list, so it's sent only when changed
+            if (!m_allowedUpdatesSent)
+                len += printAllowedUpdates(payload + len, BUFFER_SMALL - len);
+            snprintf(payload + len, BUFFER_SMALL - len, "}");
             sendCommand("getUpdates", payload);
+            // Not sent (i.e. no connection)
+            if (m_main.pending() == 0)
+                pollResult(false);
         }
     }
 
-    if (telegramClient->connected() && telegramClient->available())
+    if (telegramClient->connected() && m_main.rx.available())
     {
-        // We have a message, parse data received
-        bool close_connection = false;
-        uint16_t len = 0, pos = 0;
-        // Skip headers
-        while (telegramClient->connected())
+        // Parse only the data received so far: a reply split in more TLS records
+        // is completed with next calls, so the main loop never waits for it
+        if (!readHeaders(m_main))
         {
-            String line = telegramClient->readStringUntil('\n');
-            if (line == "\r")
-                break;
-            if (line.indexOf("close") > -1)
-            {
-                close_connection = true;
-            }
-            if (line.indexOf("Content-Length:") > -1)
-            {
-                len = line.substring(strlen("Content-Length: ")).toInt();
-            }
+            log_error("Invalid HTTP response");
+            m_main.stop();
+            return false;
         }
+        if (!m_main.response.headersDone())
+            return false;
 
-        // If there are incoming bytes available from the server, read them and store:
-        m_rxbuffer = "";
-        for (uint32_t timeout = millis(); (millis() - timeout > 1000) || pos < len;)
-        {
-            if (telegramClient->available())
-            {
-                m_rxbuffer += (char)telegramClient->read();
-                pos++;
-            }
-        }
-        m_waitingReply = false;
+        // Body will be deserialized directly from client (or in place, once received)
+        if (m_streamParsing ? !bodyBuffered() : !readBody(m_main))
+            return false;
+
+        // Replies are received in the same order of requests
+        TelegramConnection::Request request = m_main.pop();
+        m_pollReply = request.kind == TelegramConnection::RequestPoll;
+        m_replyId = request.id;
         m_lastmsg_timestamp = millis();
 
-        // WiFiNINA error "No socket avalaible"
-        // (close the connection before it became inactive from server side)
-        #if !defined(ESP32) && !defined(ESP8266)
-            static uint32_t closeTime;
-            // Telegram server close opened connections more ore less after 255 seconds
-            if(millis() - closeTime > 240000) {
-                closeTime = millis();
-                log_info("Connection closed (WiFiNINA)");
-                telegramClient->stop();
-            }
-        #endif
+        // Result is recorded once the body is parsed
+        if (m_streamParsing)
+            return true;
+        TBResult result;
+        parseResult(request.kind, m_main.response, m_rxbuffer.c_str(), result);
+        endResponse(m_main);
+        endRequest(request, result);
+
+        if (result.ok)
+            return true;
+        log_error(m_rxbuffer.c_str());
+        return false;
+    }
+    return false;
+}
 
-        if (close_connection)
+// Names of update types, in the same order of UpdateType bits
+static const char *const updateTypeNames[] = {
+    "message", "edited_message", "channel_post", "edited_channel_post",
+    "business_connection", "business_message", "edited_business_message", "deleted_business_messages",
+    "message_reaction", "message_reaction_count", "inline_query", "chosen_inline_result",
+    "callback_query", "shipping_query", "pre_checkout_query", "purchased_paid_media",
+    "poll", "poll_answer", "my_chat_member", "chat_member",
+    "chat_join_request", "chat_boost", "removed_chat_boost"
+};
+
+// Print the "allowed_updates" JSON field (can be used also with setWebhook)
+size_t AsyncTelegram2::printAllowedUpdates(char *buffer, size_t size)
+{
+    size_t len = snprintf(buffer, size, ",\"allowed_updates\":[");
+    bool first = true;
+    for (uint8_t i = 0; i < sizeof(updateTypeNames) / sizeof(updateTypeNames[0]) && len < size; i++)
+    {
+        if (m_allowedUpdates & (1UL << i))
         {
-            telegramClient->stop();
-            log_info("Connection closed from server");
+            len += snprintf(buffer + len, size - len, first ? "\"%s\"" : ",\"%s\"", updateTypeNames[i]);
+            first = false;
         }
+    }
+    if (len < size)
+        len += snprintf(buffer + len, size - len, "]");
+    return len < size ? len : size - 1;
+}
 
-        if (m_rxbuffer.indexOf("\"ok\":true") > -1)
-        {
-            if (m_sentCallback != nullptr && m_waitSent)
-            {
-                if (m_rxbuffer.indexOf(String(m_lastSentMsgId)) > -1)
-                {
-                    m_sentCallback(m_waitSent);
-                    m_waitSent = false;
-                }
-            }
+// Parse the response headers received so far (it doesn't wait for the rest)
+// returns: false if the response is not valid HTTP
+bool AsyncTelegram2::readHeaders(TelegramConnection &conn)
+{
+    if (conn.response.headersDone())
+        return true;
+    if (conn.response.parse(conn.rx) != HttpResponse::Body)
+        return conn.response.state() != HttpResponse::Error;
+
+    conn.closeConnection = conn.response.closeConnection();
+    // Body is read from conn.body (also when it's copied in reply buffer)
+    if (conn.response.chunked())
+        conn.body.beginChunked(&conn.rx);
+    else
+        conn.body.begin(&conn.rx, conn.response.contentLength());
+    replyBuffer(conn) = "";
+    return true;
+}
+
+// Buffer of the replies received on a connection
+String &AsyncTelegram2::replyBuffer(TelegramConnection &conn)
+{
+    return &conn == &m_main ? m_rxbuffer : conn.reply;
+}
+
+// Append the part of body received so far to the reply buffer
+// returns: true when the whole body was read
+bool AsyncTelegram2::readBody(TelegramConnection &conn)
+{
+    String &reply = replyBuffer(conn);
+    char chunk[129];
+    int len;
+    while ((len = conn.body.read((uint8_t *)chunk, sizeof(chunk) - 1)) > 0)
+    {
+        chunk[len] = '\0';
+        reply += chunk;
+    }
+    return conn.body.finished();
+}
+
+// With stream parsing, the body is parsed once it's in the receive buffer
+// returns: true when it was received completely (or the buffer is full)
+bool AsyncTelegram2::bodyBuffered()
+{
+    m_main.rx.fill();
+    size_t len = m_main.rx.size();
+    if (len == m_main.rx.capacity())
+        return true;
+    // The reply to a pipelined request can follow the body in the buffer
+    return m_main.body.buffered();
+}
+
+// Wait the whole response (blocking commands)
+// returns: false on invalid response or timeout
+bool AsyncTelegram2::waitResponse(TelegramConnection &conn)
+{
+    for (uint32_t start = millis(); millis() - start < SERVER_TIMEOUT;)
+    {
+        if (!readHeaders(conn))
+            return false;
+        if (conn.response.headersDone() && readBody(conn))
             return true;
+        if (!conn.rx.available() && !conn.client->connected())
+            break;
+        yield();
+    }
+    // Next response can't be found if this one was not read completely
+    conn.closeConnection = true;
+    return false;
+}
+
+// Close the connection (if requested) once the whole response has been read
+void AsyncTelegram2::endResponse(TelegramConnection &conn)
+{
+    // WiFiNINA error "No socket avalaible"
+    // (close the connection before it became inactive from server side)
+    #if !defined(ESP32) && !defined(ESP8266)
+        static uint32_t closeTime;
+        // Telegram server close opened connections more ore less after 255 seconds
+        if(millis() - closeTime > 240000) {
+            closeTime = millis();
+            log_info("Connection closed (WiFiNINA)");
+            conn.stop();
+        }
+    #endif
+
+    if (conn.closeConnection)
+    {
+        // Replies to pipelined requests are lost
+        conn.stop();
+        log_info("Connection closed from server");
+    }
+    conn.response.begin();
+}
+
+// Deserialize the reply received with getUpdates()
+DeserializationError AsyncTelegram2::deserializeResponse(JsonDocument &doc)
+{
+#if !TELEGRAM_SAX_PARSER
+    // Keep in memory only the fields of updates used by the library
+    bool filter = m_pollReply && m_updateFilterEnabled;
+#endif
+    if (!m_streamParsing)
+    {
+#if !TELEGRAM_SAX_PARSER
+        if (filter)
+            return deserializeJson(doc, m_rxbuffer, DeserializationOption::Filter(m_updateFilter));
+#endif
+        return deserializeJson(doc, m_rxbuffer);
+    }
+
+    DeserializationError err;
+    if (!m_main.body.chunked() && m_main.response.contentLength() <= m_main.rx.capacity())
+    {
+        // The whole body fits in receive buffer: parse it in place
+        if (m_main.rx.wait(m_main.response.contentLength(), SERVER_TIMEOUT))
+        {
+            const char *body = (const char *)m_main.rx.data(m_main.response.contentLength());
+#if !TELEGRAM_SAX_PARSER
+            if (filter)
+                err = deserializeJson(doc, body, m_main.response.contentLength(), DeserializationOption::Filter(m_updateFilter));
+            else
+#endif
+                err = deserializeJson(doc, body, m_main.response.contentLength());
+            m_main.rx.consume(m_main.response.contentLength());
         }
         else
         {
-            log_error(m_rxbuffer.c_str());
-            if (m_sentCallback != nullptr && m_waitSent)
-            {
-                m_waitSent = false;
-                m_sentCallback(m_waitSent);
-            }
-            return false;
+            err = DeserializationError::IncompleteInput;
+            m_main.rx.consume(m_main.rx.size());
         }
     }
-    return false;
+    else
+    {
+        // Parse JSON while reading from client: the raw body is never stored
+#if !TELEGRAM_SAX_PARSER
+        if (filter)
+            err = deserializeJson(doc, m_main.body, DeserializationOption::Filter(m_updateFilter));
+        else
+#endif
+            err = deserializeJson(doc, m_main.body);
+        // Discard what is left of the body (trailing bytes or unparsed data)
+        m_main.body.drain(SERVER_TIMEOUT);
+    }
+
+    TBResult result;
+    result.httpStatus = m_main.response.status();
+    result.retryAfter = m_main.response.retryAfter();
+    endResponse(m_main);
+    if (err)
+        result.description = err.c_str();
+    else
+    {
+        result.ok = doc["ok"].as<bool>();
+        result.errorCode = doc["error_code"].as<int32_t>();
+        if (doc["description"])
+            result.description = doc["description"].as<const char *>();
+        if (doc["parameters"]["retry_after"])
+            result.retryAfter = doc["parameters"]["retry_after"];
+        if (!m_pollReply)
+            result.messageId = doc["result"]["message_id"].as<int32_t>();
+    }
+    TelegramConnection::Request request = {m_pollReply ? TelegramConnection::RequestPoll : TelegramConnection::RequestCommand, m_replyId};
+    endRequest(request, result);
+
+    if (!err && !result.ok) {
+        debugJson(doc, Serial);
+    }
+    return err;
 }
 
-// Parse message received from Telegram server
-MessageType AsyncTelegram2::getNewMessage(TBMessage &message)
+#if TELEGRAM_SAX_PARSER
+// Decode the reply received with getUpdates() in a single pass, without JSON document
+void AsyncTelegram2::decodeResponse()
 {
-    message.messageType = MessageNoData;
+    UpdateParser parser;
+    bool inPlace = false;
+    if (!m_streamParsing)
+    {
+        parser.begin(m_rxbuffer.c_str(), m_rxbuffer.length());
+    }
+    else if (!m_main.body.chunked() && m_main.response.contentLength() <= m_main.rx.capacity() && m_main.rx.wait(m_main.response.contentLength(), SERVER_TIMEOUT))
+    {
+        // The whole body fits in receive buffer: parse it in place
+        parser.begin((const char *)m_main.rx.data(m_main.response.contentLength()), m_main.response.contentLength());
+        inPlace = true;
+    }
+    else
+    {
+        // Parse while reading from client: the raw body is never stored
+        parser.begin(m_main.body);
+    }
+
+    // Decode all the updates of this batch in the local queue
+    uint32_t lastUpdateId = 0;
+    TBCompactMessage update;
+    while (true)
+    {
+        bool full = m_queueCount == MAX_UPDATES_QUEUE;
+        TBCompactMessage &slot = full ? update : m_updatesQueue[(m_queueHead + m_queueCount) % MAX_UPDATES_QUEUE];
+        if (!parser.next(slot, m_arena))
+            break;
+        if (parser.updateId() > lastUpdateId)
+            lastUpdateId = parser.updateId();
+
+        // Only the reply to forwardMessage command is queued (not other sent messages)
+        if (parser.isObject() && slot.messageType != MessageForwarded)
+            continue;
+
+        if (full)
+            continue;
+        if (slot.messageType == MessageNoData && m_unknownUpdates && parser.updateId())
+        {
+            // Keep the JSON text of the update (not available if parsed from client)
+            slot.messageType = MessageUnknown;
+            slot.update = m_arena.begin();
+            m_arena.append(parser.updateData(), parser.updateLength());
+            m_arena.end();
+        }
+        if (slot.messageType != MessageNoData)
+            m_queueCount++;
+    }
+
+    if (inPlace)
+        m_main.rx.consume(m_main.response.contentLength());
+    else if (m_streamParsing)
+        m_main.body.drain(SERVER_TIMEOUT);
+
+    // Result of buffered reply was already recorded by getUpdates()
+    if (m_streamParsing)
+    {
+        TBResult result;
+        result.httpStatus = m_main.response.status();
+        result.retryAfter = parser.retryAfter() ? parser.retryAfter() : m_main.response.retryAfter();
+        result.ok = parser.ok() && !parser.error();
+        result.errorCode = parser.errorCode();
+        result.description = parser.description();
+        if (parser.isObject())
+            result.messageId = parser.messageId();
+        endResponse(m_main);
+        TelegramConnection::Request request = {m_pollReply ? TelegramConnection::RequestPoll : TelegramConnection::RequestCommand, m_replyId};
+        endRequest(request, result);
+    }
+    m_rxbuffer = "";
+
+    if (parser.error())
+    {
+        log_error("Update parser failed");
+        // Skip this update id due to the impossibility to parse correctly
+        if (parser.updateId() > lastUpdateId)
+            lastUpdateId = parser.updateId();
+    }
+    else if (!parser.ok())
+    {
+        log_error(parser.description());
+    }
+    else if (m_pollReply)
+        m_allowedUpdatesSent = true;
+
+    // Confirm the whole batch with next getUpdates request
+    if (lastUpdateId)
+        m_lastUpdateId = lastUpdateId + 1;
+}
+#endif
 
+// Poll server for new updates (only when all queued updates were read)
+// returns true if there is an update in the queue
+bool AsyncTelegram2::readUpdates(int64_t chatId)
+{
     // Last sent message timeout
     if (millis() - m_lastSentTime > m_sentTimeout && m_waitSent && m_sentCallback != nullptr)
     {
@@ -333,15 +1151,20 @@ MessageType AsyncTelegram2::getNewMessage(TBMessage &message)
     }
 
     // We have a message, parse data received
-    if (getUpdates())
+    if (m_queueCount == 0 && getUpdates())
     {
-        #if ARDUINOJSON_VERSION_MAJOR > 6
-        JsonDocument updateDoc;
-        #else
-        DynamicJsonDocument updateDoc(m_JsonBufferSize);
+        // Strings of previous batch are no more referenced
+        m_arena.clear();
+#if TELEGRAM_SAX_PARSER
+        (void)chatId;
+        decodeResponse();
+#else
+        #if ARDUINOJSON_VERSION_MAJOR < 7
+        if (m_updatesDoc.capacity() != m_JsonBufferSize)
+            m_updatesDoc = DynamicJsonDocument(m_JsonBufferSize);
         #endif
 
-        DeserializationError err = deserializeJson(updateDoc, m_rxbuffer);
+        DeserializationError err = deserializeResponse(m_updatesDoc);
         if (err)
         {
             log_error("deserializeJson() failed\n");
@@ -349,183 +1172,167 @@ MessageType AsyncTelegram2::getNewMessage(TBMessage &message)
             log_error();
             log_error(m_rxbuffer);
             // Skip this message id due to the impossibility to parse correctly
-            m_lastUpdateId = m_rxbuffer.substring(m_rxbuffer.indexOf(F("\"update_id\":")) + strlen("\"update_id\":")).toInt() + 1;
+            if (m_streamParsing)
+            {
+                // Only the partially parsed document is available
+                uint32_t updateID = m_updatesDoc["result"][0]["update_id"];
+                if (updateID)
+                    m_lastUpdateId = updateID + 1;
+            }
+            else
+                m_lastUpdateId = m_rxbuffer.substring(m_rxbuffer.indexOf(F("\"update_id\":")) + strlen("\"update_id\":")).toInt() + 1;
             m_rxbuffer = "";
 
             // Inform the user about parsing error (blocking)
-            sendTo(message.chatId, "[ERROR] - No memory: inrease buffer size with \"setJsonBufferSize(buf_size)\" method");
-            return MessageNoData;
+            sendTo(chatId, "[ERROR] - No memory: inrease buffer size with \"setJsonBufferSize(buf_size)\" method");
+            return false;
         }
-        updateDoc.shrinkToFit();
 
         m_rxbuffer = "";
-        if (!updateDoc["result"])
+        if (m_pollReply && m_updatesDoc["ok"])
+            m_allowedUpdatesSent = true;
+
+        if (!m_updatesDoc["result"])
         {
             log_error("JSON data not expected");
-            serializeJsonPretty(updateDoc, Serial);
-            return MessageNoData;
+            serializeJsonPretty(m_updatesDoc, Serial);
+            return false;
         }
 
-        JsonVariantConst result;
-        if (updateDoc["result"].is<JsonArray>())
-            result = updateDoc["result"][0].as<JsonVariant>();
-        else
-            result = updateDoc["result"].as<JsonVariant>();
-
-        if (result.isNull())
-            return MessageNoData;
-
-        // This a reply after send message
-        if (result["message_id"])
+        if (m_updatesDoc["result"].is<JsonArray>())
         {
-            // m_lastSentMsgId = result["message_id"];
-            if (m_sentCallback != nullptr && m_waitSent)
+            // Queue all the updates of this batch, they are decoded only when read
+            uint32_t lastUpdateId = 0;
+            for (JsonVariantConst result : m_updatesDoc["result"].as<JsonArray>())
             {
-                m_waitSent = false;
-                if (result["message_id"]> m_lastSentMsgId  )
-                {
-                    m_lastSentMsgId = result["message_id"];
-                    m_sentCallback(true);
-                }
-                else {
-                    m_sentCallback(false);
-                }
+                uint32_t updateID = result["update_id"];
+                if (updateID > lastUpdateId)
+                    lastUpdateId = updateID;
+
+                if (m_queueCount == MAX_UPDATES_QUEUE)
+                    continue;
+                debugJson(result, Serial);
+                TBLazyMessage &slot = m_updatesQueue[(m_queueHead + m_queueCount) % MAX_UPDATES_QUEUE];
+                if (slot.begin(result, m_unknownUpdates) != MessageNoData)
+                    m_queueCount++;
             }
-        }
 
-        uint32_t updateID = result["update_id"];
-        if (updateID)
-        {
-            m_lastUpdateId = updateID + 1;
+            // Confirm the whole batch with next getUpdates request
+            if (lastUpdateId)
+                m_lastUpdateId = lastUpdateId + 1;
         }
         else
         {
+            // Reply to a sent message (already reported with its request)
+            JsonVariantConst result = m_updatesDoc["result"].as<JsonVariant>();
+
             // In case of forwarded message reply, we need to get original text
             // so don't skip parsing the reply to just sent forwarMessage command
-            if (!result["forward_from"])
-                return MessageNoData;
+            if (result["forward_from"])
+            {
+                TBLazyMessage &slot = m_updatesQueue[m_queueHead];
+                if (slot.begin(result) != MessageNoData)
+                    m_queueCount++;
+            }
         }
+#endif
+    }
+    return m_queueCount > 0;
+}
 
-        debugJson(result, Serial);
-        if (result["callback_query"]["id"])
-        {
-            // this is a callback query
-            message.sender.id = result["callback_query"]["from"]["id"];
-            message.sender.username = result["callback_query"]["from"]["username"].as<String>();
-            message.sender.firstName = result["callback_query"]["from"]["first_name"].as<String>();
-            message.sender.lastName = result["callback_query"]["from"]["last_name"].as<String>();
+void AsyncTelegram2::addInlineKeyboard(InlineKeyboard *keyb)
+{
+    keyb->m_callbacks = &m_queryCallbacks;
+    for (InlineKeyboard::InlineButton *button = keyb->_firstButton; button != nullptr; button = button->nextButton)
+    {
+        if (button->argCallback != nullptr)
+            m_queryCallbacks.add(button->btnName, button->argCallback);
+    }
+}
 
-            message.chatId = result["callback_query"]["message"]["chat"]["id"];
-            message.messageID = result["callback_query"]["message"]["message_id"];
-            message.date = result["callback_query"]["message"]["date"];
-            message.chatInstance = result["callback_query"]["chat_instance"];
-            message.callbackQueryID = result["callback_query"]["id"];
-            message.callbackQueryData = result["callback_query"]["data"].as<String>();
-            message.text = result["callback_query"]["message"]["text"].as<String>();
-            message.messageType = MessageQuery;
+// Call keyboard callbacks (button queries) and command handlers (text messages)
+void AsyncTelegram2::runCallbacks(const TBMessage &message)
+{
+    if (message.messageType == MessageQuery)
+        m_queryCallbacks.call(message);
+    else if (message.messageType == MessageText && m_router != nullptr)
+        m_router->dispatch(message, m_botusername.c_str());
+}
 
-            // Check if callback function is defined for this button query
-            for (uint8_t i = 0; i < m_keyboardCount; i++)
-                m_keyboards[i]->checkCallback(message);
-        }
-        else if (result["forward_from"])
-        {
-            // this is a forwarded message from user or group
-            message.sender.id = result["forward_from"]["id"];
-            message.sender.username = result["forward_from"]["username"].as<String>();
-            message.sender.firstName = result["forward_from"]["first_name"].as<String>();
-            message.sender.lastName = result["forward_from"]["last_name"].as<String>();
-            message.text = result["text"].as<String>();
-            message.messageType = MessageForwarded;
-        }
-		else if (result["channel_post"])
-        {
-            // this is a channel message
-            message.sender.id = result["channel_post"]["sender_chat"]["id"];
-            message.sender.username = result["channel_post"]["sender_chat"]["title"].as<String>();
-			message.chatId = result["channel_post"]["chat"]["id"];
-            message.text = result["channel_post"]["text"].as<String>();
-            message.messageType = MessageText;
-        }
+// Callbacks are called with a TBMessage: fill it only when there is one to call
+template <typename Message>
+void AsyncTelegram2::runCallbacks(const Message &message, const char *text)
+{
+    const char *args;
+    size_t length;
+    if ((message.messageType == MessageQuery && m_queryCallbacks.size()) ||
+        (message.messageType == MessageText && m_router != nullptr &&
+         m_router->find(text, m_botusername.c_str(), args, length) != nullptr))
+    {
+        TBMessage msg;
+        message.copyTo(msg);
+        runCallbacks(msg);
+    }
+}
 
-        else if (result["message"]["message_id"])
-        {
+MessageType AsyncTelegram2::getNewMessage(TBMessage &message)
+{
+    if (!readUpdates(message.chatId))
+    {
+        message.messageType = MessageNoData;
+        return MessageNoData; // waiting for reply from server
+    }
 
-            // this is a message
-            message.sender.id = result["message"]["from"]["id"];
-            message.sender.username = result["message"]["from"]["username"].as<String>();
-            message.sender.firstName = result["message"]["from"]["first_name"].as<String>();
-            message.sender.lastName = result["message"]["from"]["last_name"].as<String>();
+    // Strings already allocated in message are reused
+    m_updatesQueue[m_queueHead].copyTo(message);
+    m_queueHead = (m_queueHead + 1) % MAX_UPDATES_QUEUE;
+    m_queueCount--;
 
-            message.messageID = result["message"]["message_id"];
-            message.chatId = result["message"]["chat"]["id"];
-            message.date = result["message"]["date"];
+    runCallbacks(message);
+    return message.messageType;
+}
 
-            if (result["message"]["location"])
-            {
-                // this is a location message
-                message.location.longitude = result["message"]["location"]["longitude"];
-                message.location.latitude = result["message"]["location"]["latitude"];
-                message.messageType = MessageLocation;
-            }
-            else if (result["message"]["contact"])
-            {
-                // this is a contact message
-                message.contact.id = result["message"]["contact"]["user_id"];
-                message.contact.firstName = result["message"]["contact"]["first_name"].as<String>();
-                message.contact.lastName = result["message"]["contact"]["last_name"].as<String>();
-                message.contact.phoneNumber = result["message"]["contact"]["phone_number"].as<String>();
-                message.contact.vCard = result["message"]["contact"]["vcard"].as<String>();
-                message.messageType = MessageContact;
-            }
-            else if (result["message"]["new_chat_member"])
-            {
-                // this is a add member message
-                message.member.isBot = result["message"]["new_chat_member"]["is_bot"];
-                message.member.id = result["message"]["new_chat_member"]["id"];
-                message.member.firstName = result["message"]["new_chat_member"]["first_name"].as<String>();
-                message.member.lastName = result["message"]["new_chat_member"]["last_name"].as<String>();
-                message.member.username = result["message"]["new_chat_member"]["username"].as<String>();
-                message.messageType = MessageNewMember;
-            }
-            else if (result["message"]["left_chat_member"])
-            {
-                // this is a left member message
-                message.member.isBot = result["message"]["new_chat_member"]["is_bot"];
-                message.member.id = result["message"]["new_chat_member"]["id"];
-                message.member.firstName = result["message"]["new_chat_member"]["first_name"].as<String>();
-                message.member.lastName = result["message"]["new_chat_member"]["last_name"].as<String>();
-                message.member.username = result["message"]["new_chat_member"]["username"].as<String>();
-                message.messageType = MessageLeftMember;
-            }
-            else if (result["message"]["document"])
-            {
-                // this is a document message
-                message.document.file_id = result["message"]["document"]["file_id"].as<String>();
-                message.document.file_name = result["message"]["document"]["file_name"].as<String>();
-                message.text = result["message"]["caption"].as<String>();
-                message.document.file_exists = getFile(message.document);
-                message.messageType = MessageDocument;
-            }
-            else if (result["message"]["reply_to_message"])
-            {
-                // this is a reply to message
-                message.text = result["message"]["text"].as<String>();
-                message.messageType = MessageReply;
-            }
-            else if (result["message"]["text"])
-            {
-                // this is a text message
-                message.text = result["message"]["text"].as<String>();
-                message.messageType = MessageText;
-            }
-        }
-        // m_lastSentMsgId = message.messageID;
-        return message.messageType;
+MessageType AsyncTelegram2::getNewMessage(TBCompactMessage &message)
+{
+    if (!readUpdates(message.chatId))
+    {
+        message.messageType = MessageNoData;
+        return MessageNoData;
     }
-    return MessageNoData; // waiting for reply from server
+
+#if TELEGRAM_SAX_PARSER
+    message = m_updatesQueue[m_queueHead];
+#else
+    // Only the strings of this message are in the arena
+    m_arena.clear();
+    m_updatesQueue[m_queueHead].copyTo(message, m_arena);
+#endif
+    m_queueHead = (m_queueHead + 1) % MAX_UPDATES_QUEUE;
+    m_queueCount--;
+
+    runCallbacks(message, message.c_str(message.text));
+    return message.messageType;
 }
 
+MessageType AsyncTelegram2::getNewMessage(TBLazyMessage &message)
+{
+    if (!readUpdates(message.chatId()))
+    {
+        message.messageType = MessageNoData;
+        return MessageNoData;
+    }
+
+#if TELEGRAM_SAX_PARSER
+    message.begin(m_updatesQueue[m_queueHead]);
+#else
+    message = m_updatesQueue[m_queueHead];
+#endif
+    m_queueHead = (m_queueHead + 1) % MAX_UPDATES_QUEUE;
+    m_queueCount--;
+
+    runCallbacks(message, message.text());
+    return message.messageType;
+}
 
 // Blocking getMe function (we wait for a reply from Telegram server)
 bool AsyncTelegram2::getMe()
@@ -538,7 +1345,7 @@ bool AsyncTelegram2::getMe()
     }
     // StaticJsonDocument<BUFFER_SMALL> root;
     JSON_DOC(BUFFER_SMALL);
-    deserializeJson(root, m_rxbuffer);
+    deserializeJson(root, replyBuffer(*m_connections[TrafficCommands]));
     debugJson(root, Serial);
     m_botusername = root["result"]["username"].as<String>();
     return true;
@@ -557,7 +1364,7 @@ bool AsyncTelegram2::getFile(TBDocument &doc)
     }
     // StaticJsonDocument<BUFFER_MEDIUM> fileDoc;
     JSON_DOC(BUFFER_MEDIUM);
-    deserializeJson(root, m_rxbuffer);
+    deserializeJson(root, replyBuffer(*m_connections[TrafficCommands]));
     debugJson(root, Serial);
     doc.file_path = "https://api.telegram.org/file/bot";
     doc.file_path += m_token;
@@ -567,6 +1374,135 @@ bool AsyncTelegram2::getFile(TBDocument &doc)
     return true;
 }
 
+bool AsyncTelegram2::downloadFile(const TBDocument &document, Print &sink, size_t offset)
+{
+    // Path of the file on server, i.e. "/file/bot<token>/documents/file_1.pdf"
+    TBDocument doc;
+    doc.file_size = document.file_size;
+    const char *path = strstr(document.file_path.c_str(), "/file/bot");
+    if (path == nullptr)
+    {
+        doc.file_id = document.file_id;
+        if (!getFile(doc) || (path = strstr(doc.file_path.c_str(), "/file/bot")) == nullptr)
+        {
+            log_error("File path not available");
+            return false;
+        }
+    }
+
+    TelegramConnection &conn = *m_connections[TrafficCommands];
+    if (m_upload.active() && m_uploadConn == &conn)
+        finishUpload();
+    // The file is read straight from the connection: replies to previous requests first
+    while (conn.pending())
+        skipReply(conn);
+
+    size_t received = offset;
+    size_t total = doc.file_size > 0 ? doc.file_size : 0;
+    uint8_t buffer[DOWNLOAD_BUFFER_SIZE];
+    uint32_t backoff = 0;
+    for (uint8_t attempt = 0; attempt <= DOWNLOAD_RETRIES; attempt++)
+    {
+        if (attempt) {
+            // Same delay of failed polls: an unreachable server isn't tried again at once
+            backoff = backoff ? backoff * 2 : m_minUpdateTime;
+            if (backoff > MAX_POLL_BACKOFF)
+                backoff = MAX_POLL_BACKOFF;
+            log_info("Download interrupted, resuming");
+            delay(backoff);
+        }
+        if (!checkConnection(conn))
+            continue;
+
+        RequestWriter writer(*conn.client);
+        writer.print("GET ");
+        writer.print(path);
+        writer.print(" HTTP/1.1\r\nHost: ");
+        writer.print(m_host);
+        writer.print("\r\nConnection: keep-alive\r\n");
+        // Only the part of the file still missing
+        if (received)
+        {
+            writer.print("Range: bytes=");
+            writer.print(received);
+            writer.print("-\r\n");
+        }
+        writer.print("\r\n");
+        if (!writer.end())
+        {
+            conn.stop();
+            continue;
+        }
+        conn.push(TelegramConnection::RequestCommand);
+
+        // Wait for the headers
+        uint32_t lastData = millis();
+        while (readHeaders(conn) && !conn.response.headersDone() && millis() - lastData < SERVER_TIMEOUT &&
+               (conn.rx.available() || conn.client->connected()))
+            yield();
+        if (!conn.response.headersDone())
+        {
+            conn.stop();
+            continue;
+        }
+
+        // A server ignoring Range sends the whole file again: bytes already written are skipped
+        size_t skip = 0;
+        uint16_t status = conn.response.status();
+        if (status == 200)
+        {
+            skip = received;
+            if (!conn.response.chunked())
+                total = conn.response.contentLength();
+        }
+        else if (status == 206 && !conn.response.chunked())
+            total = received + conn.response.contentLength();
+        else if (status != 206)
+        {
+            log_debug("Download failed, HTTP status %u\n", status);
+            conn.stop();
+            return false;
+        }
+
+        lastData = millis();
+        while (!conn.body.finished())
+        {
+            int len = conn.body.read(buffer, sizeof(buffer));
+            if (len <= 0)
+            {
+                // Connection dropped (or no data for too long): resume with a new request
+                if ((!conn.rx.available() && !conn.client->connected()) || millis() - lastData > SERVER_TIMEOUT)
+                    break;
+                yield();
+                continue;
+            }
+            lastData = millis();
+
+            size_t start = skip < (size_t)len ? skip : len;
+            skip -= start;
+            if (sink.write(buffer + start, len - start) != len - start)
+            {
+                log_error("Download: file not written");
+                conn.stop();
+                return false;
+            }
+            received += len - start;
+            if (m_downloadCallback != nullptr && len > (int)start)
+                m_downloadCallback(received, total);
+        }
+
+        if (conn.body.finished())
+        {
+            conn.pop();
+            endResponse(conn);
+            return true;
+        }
+        conn.stop();
+    }
+    log_error("Download failed");
+    return false;
+}
+
 bool AsyncTelegram2::noNewMessage()
 {
 
@@ -577,6 +1513,12 @@ bool AsyncTelegram2::noNewMessage()
     {
         delay(100);
     }
+    if (m_streamParsing)
+    {
+        // Consume the body of reply still pending on client
+        JSON_DOC(m_JsonBufferSize);
+        deserializeResponse(root);
+    }
     return true;
 }
 
@@ -586,6 +1528,7 @@ bool AsyncTelegram2::sendMessage(const TBMessage &msg, const char *message, char
     if (!strlen(message))
         return false;
     m_waitSent = true;
+    m_sentRequestId = 0;
     m_lastSentTime = millis();
 
     JSON_DOC(m_JsonBufferSize);
@@ -636,9 +1579,7 @@ bool AsyncTelegram2::sendMessage(const TBMessage &msg, const char *message, char
         }
     }
     root.shrinkToFit();
-    String payload;
-    serializeJson(root, payload);
-    return sendCommand("sendMessage", payload.c_str(),  wait);
+    return sendCommand("sendMessage", root, wait);
 }
 
 bool AsyncTelegram2::forwardMessage(const TBMessage &msg, const int64_t to_chatid)
@@ -648,9 +1589,7 @@ bool AsyncTelegram2::forwardMessage(const TBMessage &msg, const int64_t to_chati
     root["from_chat_id"] = msg.chatId;
     root["message_id"] = msg.messageID;
     root.shrinkToFit();
-    String payload;
-    serializeJson(root, payload);
-    return sendCommand("forwardMessage", payload.c_str());
+    return sendCommand("forwardMessage", root);
 }
 
 bool AsyncTelegram2::sendPhotoByUrl(const int64_t &chat_id, const char *url, const char *caption)
@@ -663,9 +1602,7 @@ bool AsyncTelegram2::sendPhotoByUrl(const int64_t &chat_id, const char *url, con
     root["photo"] = url;
     root["caption"] = caption;
     root.shrinkToFit();
-    String payload;
-    serializeJson(root, payload);
-    return sendCommand("sendPhoto", payload.c_str());
+    return sendCommand("sendPhoto", root);
 }
 
 bool AsyncTelegram2::sendAnimationByUrl(const int64_t &chat_id, const char *url, const char *caption)
@@ -678,9 +1615,7 @@ bool AsyncTelegram2::sendAnimationByUrl(const int64_t &chat_id, const char *url,
     root["video"] = url;
     root["caption"] = caption;
     root.shrinkToFit();
-    String payload;
-    serializeJson(root, payload);
-    return sendCommand("sendVideo", payload.c_str());
+    return sendCommand("sendVideo", root);
 }
 
 bool AsyncTelegram2::sendToChannel(const char *channel, const char *message, bool silent)
@@ -704,9 +1639,7 @@ bool AsyncTelegram2::sendToChannel(const char *channel, const char *message, boo
         root["parse_mode"] = "MarkdownV2";
         break;
     }
-    String payload;
-    serializeJson(root, payload);
-    return sendCommand("sendMessage", payload.c_str());
+    return sendCommand("sendMessage", root);
 }
 
 bool AsyncTelegram2::endQuery(const TBMessage &msg, const char *message, bool alertMode)
@@ -720,9 +1653,7 @@ bool AsyncTelegram2::endQuery(const TBMessage &msg, const char *message, bool al
     root["cache_time"] = 2;
     root["show_alert"] = alertMode ? "true" : "false";
     root.shrinkToFit();
-    String payload;
-    serializeJson(root, payload);
-    return sendCommand("answerCallbackQuery", payload.c_str(), true);
+    return sendCommand("answerCallbackQuery", root, true);
 }
 
 bool AsyncTelegram2::removeReplyKeyboard(const TBMessage &msg, const char *message, bool selective)
@@ -793,118 +1724,126 @@ void AsyncTelegram2::setformData(int64_t chat_id, const char *cmd, const char *t
     formData += type;
     formData += "\"\r\n\r\n";
 
-    request = "POST /bot";
-    request += m_token;
-    request += "/";
+    request = m_requestPrefix;
     request += cmd;
-    request +=  " HTTP/1.0"
+    request +=  " HTTP/1.1"
                 "\r\nConnection: keep-alive"
-                "\r\nHost: " TELEGRAM_HOST
-                "\r\nContent-Length: ";
+                "\r\nHost: ";
+    request += m_host;
+    request += "\r\nContent-Length: ";
     request += (size + formData.length() + strlen(END_BOUNDARY));
     request += "\r\nContent-Type: multipart/form-data; boundary=" BOUNDARY "\r\n";
 }
 
 bool AsyncTelegram2::sendStream(int64_t chat_id, const char *cmd, const char *type, const char *propName,
-                                    Stream &stream, size_t size, const char *filename,const char *caption)
+                                    Stream &stream, size_t size, const char *filename, const char *caption, bool wait)
 {
-    bool res = false;
-    if (checkConnection())
-    {
-        m_waitingReply = true;
-        String formData;
-        formData.reserve(512);
-        String request;
-        request.reserve(256);
-        setformData(chat_id, cmd, type, propName, size, formData, request, filename, caption);
-
-#if DEBUG_ENABLE
-        uint32_t t1 = millis();
-        Serial.println(request);
-        Serial.println(formData);
-#endif
-        // Send POST request to host
-        telegramClient->println(request);
-        // Body of request
-        telegramClient->print(formData);
-
-        uint8_t data[BLOCK_SIZE];
-        int n_block = trunc(size / BLOCK_SIZE);
-        int lastBytes = size - (n_block * BLOCK_SIZE);
-
-        for (uint16_t pos = 0; pos < n_block; pos++)
-        {
-            stream.readBytes(data, BLOCK_SIZE);
-            telegramClient->write(data, BLOCK_SIZE);
-            yield();
-        }
-        stream.readBytes(data, lastBytes);
-        telegramClient->write(data, lastBytes);
-
-        // Close the request form-data
-        telegramClient->println(END_BOUNDARY);
-        // telegramClient->flush();
-        m_waitSent = true;
-        m_lastSentTime = millis();
-
-#if DEBUG_ENABLE
-        log_debug("Raw upload time: %lums\n", millis() - t1);
-        t1 = millis();
-#endif
-        // Handle reply with getUpdates() method
-    }
-    else
-        Serial.println("\nError: client not connected");
-    return res;
+    return startUpload(chat_id, cmd, type, propName, &stream, nullptr, size, filename, caption, wait);
 }
 
 bool AsyncTelegram2::sendBuffer(int64_t chat_id, const char *cmd, const char *type, const char *propName, uint8_t *data, size_t size, const char *caption)
 {
-    bool res = false;
-    if (checkConnection())
+    return startUpload(chat_id, cmd, type, propName, nullptr, data, size, caption, caption, false);
+}
+
+// Start the upload of data read from stream (or from memory if stream is nullptr).
+// Without async uploads (or with wait) the whole request is written before returning
+bool AsyncTelegram2::startUpload(int64_t chat_id, const char *cmd, const char *type, const char *propName,
+                                 Stream *stream, const uint8_t *data, size_t size, const char *filename, const char *caption, bool wait)
+{
+    // One upload at a time
+    if (m_upload.active())
+        finishUpload();
+
+    TelegramConnection &conn = *m_connections[TrafficUploads];
+    reportLost(conn);
+    if (conn.full())
+        skipReply(conn);
+    if (!checkConnection(conn))
     {
-        m_waitingReply = true;
-        String formData;
-        formData.reserve(512);
-        String request;
-        request.reserve(256);
-        setformData(chat_id, cmd, type, propName, size, formData, request, caption, caption);
+        Serial.println("\nError: client not connected");
+        return false;
+    }
+
+    String formData;
+    formData.reserve(512);
+    String request;
+    request.reserve(256);
+    setformData(chat_id, cmd, type, propName, size, formData, request, filename, caption);
+    request += "\r\n";
+    request += formData;
 
 #if DEBUG_ENABLE
-        uint32_t t1 = millis();
+    Serial.println(request);
 #endif
-        // Send POST request to host
-        telegramClient->println(request);
-        // Body of request
-        telegramClient->print(formData);
+    bool ready = stream != nullptr ? m_upload.begin(request, *stream, size, END_BOUNDARY) : m_upload.begin(request, data, size, END_BOUNDARY);
+    if (!ready)
+    {
+        log_error("Upload: not enough memory");
+        return false;
+    }
 
-        // Serial.println(telegramClient->write((const uint8_t *) data, size));
-        uint16_t pos = 0;
-        int n_block = trunc(size / BLOCK_SIZE);
-        int lastBytes = size - (n_block * BLOCK_SIZE);
+    uint32_t id = newRequestId();
+    conn.push(TelegramConnection::RequestCommand, id);
+    m_uploadConn = &conn;
+    m_uploadId = id;
+    m_waitSent = true;
+    m_sentRequestId = id;
+    m_lastSentTime = millis();
 
-        for (pos = 0; pos < n_block; pos++)
-        {
-            telegramClient->write((const uint8_t *)data + pos * BLOCK_SIZE, BLOCK_SIZE);
-            yield();
-        }
-        telegramClient->write((const uint8_t *)data + pos * BLOCK_SIZE, lastBytes);
+    // Handle reply with getUpdates() method
+    if (wait || !m_asyncUpload)
+        finishUpload();
+    return !m_upload.failed();
+}
 
-        // Close the request form-data
-        telegramClient->println(END_BOUNDARY);
-        // telegramClient->flush();
-        m_waitSent = true;
-        m_lastSentTime = millis();
+// Write the part of the upload the connection can accept now
+void AsyncTelegram2::runUpload()
+{
+    if (m_upload.run(*m_uploadConn->client))
+    {
+        // Sent callback timeout starts when the whole request was written
+        if (m_waitSent && m_sentRequestId == m_uploadId)
+            m_lastSentTime = millis();
+        return;
+    }
 
+    if (m_upload.failed())
+    {
+        log_error("Upload failed");
+        // The upload and the requests sent after it are lost
+        TelegramConnection &conn = *m_uploadConn;
+        m_uploadConn = nullptr;
+        conn.stop();
+        reportLost(conn, "Upload failed");
+        return;
+    }
 #if DEBUG_ENABLE
-        log_debug("Raw upload time: %lums\n", millis() - t1);
-        t1 = millis();
+    else
+        log_debug("Raw upload time: %lums, %lu writes\n", (unsigned long)m_upload.duration(), (unsigned long)m_upload.writes());
 #endif
+    m_uploadConn = nullptr;
+}
 
+void AsyncTelegram2::finishUpload()
+{
+    while (m_upload.active())
+    {
+        runUpload();
+        yield();
     }
-    else
-        Serial.println("\nError: client not connected");
-    return res;
+}
+
+void AsyncTelegram2::cancelUpload()
+{
+    if (!m_upload.active())
+        return;
+    m_upload.end();
+    // Server waits for the rest of the body: the connection can't be used anymore
+    TelegramConnection &conn = *m_uploadConn;
+    m_uploadConn = nullptr;
+    conn.stop();
+    reportLost(conn, "Upload cancelled");
 }
 
 void AsyncTelegram2::getMyCommands(String &cmdList)
@@ -915,7 +1854,7 @@ void AsyncTelegram2::getMyCommands(String &cmdList)
         return;
     }
     JSON_DOC(BUFFER_MEDIUM);
-    DeserializationError err = deserializeJson(root, m_rxbuffer);
+    DeserializationError err = deserializeJson(root, replyBuffer(*m_connections[TrafficCommands]));
     if (err)
     {
         return;
@@ -945,7 +1884,7 @@ bool AsyncTelegram2::setMyCommands(const String &cmd, const String &desc)
     }
     JSON_DOC(BUFFER_MEDIUM);
 
-    DeserializationError err = deserializeJson(root, m_rxbuffer);
+    DeserializationError err = deserializeJson(root, replyBuffer(*m_connections[TrafficCommands]));
     if (err)
     {
         return false;
@@ -977,9 +1916,7 @@ bool AsyncTelegram2::setMyCommands(const String &cmd, const String &desc)
 #endif
     doc2["commands"] = root["result"].as<JsonArray>();
 
-    String payload;
-    serializeJson(doc2, payload);
-    return sendCommand("setMyCommands", payload.c_str(), true);
+    return sendCommand("setMyCommands", doc2, true);
 }
 
 bool AsyncTelegram2::editMessage(int64_t chat_id, int32_t message_id, const String &txt, const String &keyboard)
@@ -992,9 +1929,7 @@ bool AsyncTelegram2::editMessage(int64_t chat_id, int32_t message_id, const Stri
         root["reply_markup"] = keyboard;
     }
     root.shrinkToFit();
-    String payload;
-    serializeJson(root, payload);
-    return sendCommand("editMessageText", payload.c_str());
+    return sendCommand("editMessageText", root);
 }
 
 bool AsyncTelegram2::deleteMessage(int64_t chat_id, int32_t message_id)
@@ -1003,7 +1938,5 @@ bool AsyncTelegram2::deleteMessage(int64_t chat_id, int32_t message_id)
   root["chat_id"] = chat_id;
   root["message_id"] = message_id;
   root.shrinkToFit();
-  String payload;
-  serializeJson(root, payload);
-  return sendCommand("deleteMessage", payload.c_str());
+  return sendCommand("deleteMessage", root);
 }
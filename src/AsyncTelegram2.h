@@ -31,6 +31,13 @@
 #define DEBUG_ENABLE 0
 #endif
 
+// Decode updates with the single pass UpdateParser instead of ArduinoJson documents.
+// Set it as a global build flag: it changes the layout of AsyncTelegram2 and a
+// #define in the sketch is not seen by the library sources
+#ifndef TELEGRAM_SAX_PARSER
+#define TELEGRAM_SAX_PARSER 0
+#endif
+
 #if defined(ESP32) || defined(ESP8266)
 #define FS_SUPPORT true
 #include <FS.h>
@@ -41,19 +48,54 @@
 
 
 /*
-    This affect only inline keyboard with at least one callback function defined.
-    If you need more than MAX_INLINEKYB_CB distinct keybords with
-    callback functions associated to buttons increase this value
+    No more used: callbacks of inline keyboards are stored in a table which grows
+    as needed (see CALLBACK_TABLE_SIZE). Kept for compatibility with old sketches.
 */
 #define MAX_INLINEKYB_CB 30
 
 #define SERVER_TIMEOUT 10000
 #define MIN_UPDATE_TIME 500
 
-#define BLOCK_SIZE 1436 // 2872   // 2 * TCP_MSS
+// Max delay (ms) of getUpdates after consecutive errors: the delay starts from the
+// update time and doubles on each failed poll (or is retry_after, if longer)
+#ifndef MAX_POLL_BACKOFF
+#define MAX_POLL_BACKOFF 60000
+#endif
+
+/*
+    Max number of updates that can be retrieved with a single getUpdates request.
+    Updates are decoded in a local queue of this size and then returned one by one
+    from getNewMessage(), without new requests to server until the queue is empty.
+    The queue is a member of AsyncTelegram2: change the size only with a global
+    build flag, never with a #define in the sketch.
+*/
+#ifndef MAX_UPDATES_QUEUE
+#define MAX_UPDATES_QUEUE 8
+#endif
+
+/*
+    downloadFile() copies the file to its destination through a buffer of this size,
+    and resumes the download this many times when the connection drops.
+*/
+#ifndef DOWNLOAD_BUFFER_SIZE
+#define DOWNLOAD_BUFFER_SIZE 256
+#endif
+
+#ifndef DOWNLOAD_RETRIES
+#define DOWNLOAD_RETRIES 3
+#endif
 
 #include "DataStructures.h"
+#include "CompactMessage.h"
+#include "LazyMessage.h"
+#include "TelegramConnection.h"
+#include "UpdateParser.h"
 #include "InlineKeyboard.h"
+#include "CommandRouter.h"
+#include "SendQueue.h"
+#include "Upload.h"
+#include "RequestWriter.h"
+#include "TLSSessionCache.h"
 #include "ReplyKeyboard.h"
 
 #define TELEGRAM_HOST "api.telegram.org"
@@ -73,6 +115,8 @@ class AsyncTelegram2
 {
 
     typedef void(*SentCallback)(bool sent);
+    typedef void(*CompletionCallback)(const TBResult &result);
+    typedef void(*DownloadCallback)(size_t received, size_t total);
     typedef bool(*ConnectionRecoveryCallback)(Client &client, const char *host, uint16_t port);
 
 public:
@@ -104,7 +148,14 @@ public:
     // set the telegram token
     // params
     //   token: the telegram token
-    inline void setTelegramToken(const char *token) { m_token = (char *)token; }
+    inline void setTelegramToken(const char *token)
+    {
+        m_token = (char *)token;
+        // Start of the request line, the same for all the requests
+        m_requestPrefix = "POST /bot";
+        m_requestPrefix += token;
+        m_requestPrefix += "/";
+    }
 
     // set the interval in milliseconds for polling
     // in order to Avoid query Telegram server to much often (ms)
@@ -112,6 +163,80 @@ public:
     //    pollingTime: interval time in milliseconds
     void setUpdateTime(uint32_t pollingTime) { m_minUpdateTime = pollingTime; }
 
+    // set the max number of updates retrieved with a single getUpdates request.
+    // All updates received are stored in a local queue and returned one at time by getNewMessage()
+    // (with ArduinoJson v6, increase also the JSON buffer size with setJsonBufferSize())
+    // params:
+    //    limit: number of updates for each request (1 - MAX_UPDATES_QUEUE)
+    inline void setUpdatesLimit(uint8_t limit)
+    {
+        m_updatesLimit = constrain(limit, 1, MAX_UPDATES_QUEUE);
+    }
+
+    // Update types to be received (https://core.telegram.org/bots/api#update)
+    enum UpdateType
+    {
+        UpdateMessage               = 1UL << 0,
+        UpdateEditedMessage         = 1UL << 1,
+        UpdateChannelPost           = 1UL << 2,
+        UpdateEditedChannelPost     = 1UL << 3,
+        UpdateBusinessConnection    = 1UL << 4,
+        UpdateBusinessMessage       = 1UL << 5,
+        UpdateEditedBusinessMessage = 1UL << 6,
+        UpdateDeletedBusinessMessages = 1UL << 7,
+        UpdateMessageReaction       = 1UL << 8,
+        UpdateMessageReactionCount  = 1UL << 9,
+        UpdateInlineQuery           = 1UL << 10,
+        UpdateChosenInlineResult    = 1UL << 11,
+        UpdateCallbackQuery         = 1UL << 12,
+        UpdateShippingQuery         = 1UL << 13,
+        UpdatePreCheckoutQuery      = 1UL << 14,
+        UpdatePurchasedPaidMedia    = 1UL << 15,
+        UpdatePoll                  = 1UL << 16,
+        UpdatePollAnswer            = 1UL << 17,
+        UpdateMyChatMember          = 1UL << 18,
+        UpdateChatMember            = 1UL << 19,
+        UpdateChatJoinRequest       = 1UL << 20,
+        UpdateChatBoost             = 1UL << 21,
+        UpdateRemovedChatBoost      = 1UL << 22,
+        // Update types handled by getNewMessage()
+        UpdateDefault = UpdateMessage | UpdateChannelPost | UpdateCallbackQuery
+    };
+
+    // set which update types Telegram server has to send. Discarded types are filtered
+    // server side, so they are never transferred or parsed.
+    // The list is sent with next getUpdates request, then server will remember it.
+    // params:
+    //    types: bitwise OR of UpdateType values (i.e. UpdateMessage | UpdateCallbackQuery)
+    //           0 restores the server default (all types except chat_member and reactions)
+    inline void setAllowedUpdates(uint32_t types)
+    {
+        m_allowedUpdates = types;
+        m_allowedUpdatesSent = false;
+    }
+
+    // return also updates not handled by TBMessage (photos, edited messages, polls, ...)
+    // as MessageUnknown, instead of discarding them. Their content is available without
+    // new parsing with TBLazyMessage::update() (parsed JSON: add the needed fields with
+    // addUpdateFilter() and the update types with setAllowedUpdates()) or, with
+    // TELEGRAM_SAX_PARSER, with TBLazyMessage::rawUpdate() (JSON text of the update)
+    inline void enableUnknownUpdates(bool enable = true)
+    {
+        m_unknownUpdates = enable;
+    }
+
+    // enable long polling: getUpdates is sent with a timeout and Telegram server
+    // will hold the request until a new update is available (or timeout expires).
+    // A new request is sent as soon as previous reply has been received.
+    // The pending request holds its connection: long polling is used only when commands
+    // and uploads have a dedicated client (see setTrafficClient()), else short polling is used.
+    // params:
+    //    timeout: long polling timeout in seconds (0 = disabled, short polling)
+    inline void setLongPolling(uint16_t timeout)
+    {
+        m_longPollTimeout = timeout;
+    }
+
     // Enable a one-way fallback to insecure TLS for supported secure clients.
     // When enabled, if the first TLS handshake fails, the client switches to
     // setInsecure() and retries the Telegram connection.
@@ -153,6 +278,100 @@ public:
         }
     }
 
+    // Keep the TLS session of the main client in a cache (i.e. RTCSessionCache), so
+    // the first connection after a reset or deep sleep resumes it too. Session
+    // resumption needs a TLSSession: without one the cache is not used
+    inline void setTLSSessionCache(TLSSessionCache *cache)
+    {
+        m_sessionCache = cache;
+    }
+
+    // Resume the TLS session of the main client when it reconnects. The secure client
+    // constructor on ESP8266 sets a BearSSLSession; for other clients with a session
+    // API derive from TLSSession (nullptr: every connection is a full handshake)
+    inline void setTLSSession(TLSSession *session)
+    {
+        m_tlsSession = session;
+    }
+
+    // Open the connections with another server than TELEGRAM_HOST:TELEGRAM_PORT,
+    // i.e. a local Bot API server (host must stay valid while the bot is used)
+    inline void setTelegramServer(const char *host, uint16_t port = TELEGRAM_PORT)
+    {
+        m_host = host;
+        m_port = port;
+    }
+
+    // Number and duration of TLS handshakes (all the connections)
+    inline const TBHandshakeStats &getHandshakeStats() const
+    {
+        return m_handshakeStats;
+    }
+
+    // Deserialize getUpdates replies directly from the receive buffer instead of
+    // storing a copy of the whole HTTP body first (less RAM needed)
+    inline void enableStreamParsing(bool enable = true)
+    {
+        m_streamParsing = enable;
+    }
+
+    // Upload photos and documents from a stream or a buffer without waiting: the send
+    // function returns once the request is started, and getNewMessage() writes the data
+    // as the connection can accept it. The stream (or buffer) must be kept valid until
+    // isUploading() returns false. Files opened by the library from a filesystem are
+    // always uploaded before returning
+    inline void enableAsyncUpload(bool enable = true)
+    {
+        m_asyncUpload = enable;
+    }
+
+    // true while an upload is in progress
+    inline bool isUploading()
+    {
+        return m_upload.active();
+    }
+
+    // Bytes of the upload request already written and its whole size
+    inline size_t getUploadedBytes()
+    {
+        return m_upload.written();
+    }
+
+    inline size_t getUploadSize()
+    {
+        return m_upload.total();
+    }
+
+    // Client writes (TLS records) and time (ms) used by the current or last upload,
+    // to measure its throughput
+    inline uint32_t getUploadWrites()
+    {
+        return m_upload.writes();
+    }
+
+    inline uint32_t getUploadTime()
+    {
+        return m_upload.duration();
+    }
+
+    // Stop the upload in progress (its connection is closed)
+    void cancelUpload();
+
+    // Add a field to the filter used when updates are deserialized.
+    // By default only the fields needed to fill TBMessage are kept in memory.
+    // params:
+    //    path: field path relative to the update object, with '/' as separator
+    //          (i.e. "message/photo" or "edited_message" for the whole object)
+    // returns:
+    //    true if no error occurred (false with TELEGRAM_SAX_PARSER, without filter)
+    bool addUpdateFilter(const char *path);
+
+    // Disable the filter in order to keep all the fields of updates
+    inline void enableUpdateFilter(bool enable = true)
+    {
+        m_updateFilterEnabled = enable;
+    }
+
     // Register a generic recovery callback invoked after a failed
     // connection attempt and before the built-in insecure fallback.
     // Return true to ask the library to retry the Telegram connection.
@@ -168,6 +387,24 @@ public:
     //   true if no error
     bool getFile(TBDocument &doc);
 
+    // Download the file of a document, writing it to sink while it's received (the
+    // file is never kept whole in memory). A dropped connection is resumed from the
+    // first byte missing (HTTP Range request).
+    // params
+    //   doc   : document structure (getFile() is called if file_path is missing)
+    //   sink  : destination of the file (i.e. a fs::File open for writing)
+    //   offset: bytes already downloaded before (i.e. file opened in append mode)
+    // returns
+    //   true if the whole file was written
+    bool downloadFile(const TBDocument &doc, Print &sink, size_t offset = 0);
+
+    // This callback function will be executed while a file is downloaded, with the
+    // bytes received so far and the size of the file (0 if unknown)
+    inline void setDownloadCallback(DownloadCallback callback)
+    {
+        m_downloadCallback = callback;
+    }
+
     // get the first unread message from the queue (text and query from inline keyboard).
     // This is a destructive operation: once read, the message will be marked as read
     // so a new getMessage will read the next message (if any).
@@ -179,6 +416,16 @@ public:
     //   MessageQuery : the received message is a query (from inline keyboards)
     MessageType getNewMessage(TBMessage &message);
 
+    // same as getNewMessage(TBMessage &message), but the message is not copied in String objects:
+    // string fields are offsets in the library arena (read them with message.c_str(field))
+    // and they are valid until next call of getNewMessage()
+    MessageType getNewMessage(TBCompactMessage &message);
+
+    // same as getNewMessage(TBMessage &message), but fields are decoded only when read
+    // with the accessors of message (e.g. message.text()); strings returned are valid
+    // until next call of getNewMessage()
+    MessageType getNewMessage(TBLazyMessage &message);
+
     // send a message to the specified telegram user ID
     // params
     //   msg      : the TBMessage telegram recipient with user ID
@@ -291,14 +538,14 @@ public:
     inline bool sendPhoto(int64_t chat_id, const char *filename, fs::FS &fs, const char *caption = nullptr)
     {
         File file = fs.open(filename, "r");
-        bool res = sendStream(chat_id, "sendPhoto", "image/jpeg", "photo", file, file.size(), file.name(), caption);
+        bool res = sendStream(chat_id, "sendPhoto", "image/jpeg", "photo", file, file.size(), file.name(), caption, true);
         file.close();
         return res;
     }
     inline bool sendPhoto(const TBMessage &msg, const char *filename, fs::FS &fs, const char *caption = nullptr)
     {
         File file = fs.open(filename, "r");
-        bool res = sendStream(msg.chatId, "sendPhoto", "image/jpeg", "photo", file, file.size(), file.name(), caption);
+        bool res = sendStream(msg.chatId, "sendPhoto", "image/jpeg", "photo", file, file.size(), file.name(), caption, true);
         file.close();
         return res;
     }
@@ -337,7 +584,7 @@ public:
     {
         File file = fs.open(filename, "r");
         Serial.println(file.size());
-        bool res = sendStream(chat_id, "sendPhoto", "image/jpeg", "photo", file, file.size(), file.name(), nullptr);
+        bool res = sendStream(chat_id, "sendPhoto", "image/jpeg", "photo", file, file.size(), file.name(), nullptr, true);
         file.close();
         return res;
     }
@@ -374,6 +621,16 @@ public:
         return m_botusername.c_str();
     }
 
+    // Get the result of last request to Telegram server (successful polling of updates is
+    // not recorded). When Telegram asks to slow down (HTTP 429), messages are refused
+    // for retry_after seconds; queued messages (see setSendQueue) are sent again later
+    // return:
+    //   HTTP status, Telegram error_code and description, retry_after
+    inline const TBResult &getLastResult()
+    {
+        return m_result;
+    }
+
     // Check for no new pending message
     // (to be sure all messages was parsed, before doing something)
     // Example: OTA sketch
@@ -392,10 +649,28 @@ public:
     }
 
     // keep track of defined inline keybaord in order to call cb function
+    // (also buttons added to keyboard after this call)
     // params: pointer to inline keyboard
-    inline void addInlineKeyboard(InlineKeyboard *keyb)
+    void addInlineKeyboard(InlineKeyboard *keyb);
+
+    // set the router which dispatches bot commands (i.e. "/start") to their handlers.
+    // Handlers are called by getNewMessage() before returning the message
+    // params
+    //   router: the command router with handlers already added (nullptr to disable)
+    inline void setCommandRouter(CommandRouter *router)
     {
-        m_keyboards[m_keyboardCount++] = keyb;
+        m_router = router;
+    }
+
+    // set the queue of outgoing messages. Non blocking requests (sendMessage, editMessage, ...)
+    // are added to the queue and sent by getNewMessage() at the rate allowed by Telegram
+    // flood control, serving the chats round robin. Blocking requests and uploads are sent
+    // immediately
+    // params
+    //   queue: the send queue (nullptr to send all the requests immediately)
+    inline void setSendQueue(SendQueue *queue)
+    {
+        m_sendQueue = queue;
     }
 
     // set custom commands for bot
@@ -449,6 +724,28 @@ public:
     //   true on connected
     bool checkConnection();
 
+    // Classes of requests that can be sent with a dedicated client
+    enum TrafficClass
+    {
+        TrafficUpdates,     // getUpdates (and forwardMessage, whose reply is a message)
+        TrafficCommands,    // other API calls (send, edit, getFile, ...)
+        TrafficUploads,     // sendDocument, sendPhoto from stream or buffer
+        TrafficClassCount
+    };
+
+    // use a dedicated client for a class of requests, with its own connection
+    // (i.e. a large upload doesn't delay the updates). By default all the requests
+    // are sent with the client passed to constructor. The client has to be
+    // configured in the same way (TLS certificate, buffer sizes)
+    // params:
+    //    traffic: TrafficCommands or TrafficUploads
+    //    client : the client to be used (the same client can be used for both). A
+    //             new client for the same class replaces the previous one, and its
+    //             connection is closed
+    // returns
+    //    false if traffic is not valid or without memory
+    bool setTrafficClient(TrafficClass traffic, Client &client);
+
     // This callback function will be executed once the message was delivered succesfully
     inline void addSentCallback(SentCallback sentcb, uint32_t timeout = 1000)
     {
@@ -459,6 +756,24 @@ public:
         }
     }
 
+    // This callback function will be executed when the reply to a request is received,
+    // with the id of the request (see getLastRequestId()), the error if any and the
+    // message_id of the message sent. If the reply is lost (i.e. the connection was closed)
+    // it's executed with ok false and the reason in description. Not executed for the polling
+    // of updates
+    inline void setCompletionCallback(CompletionCallback callback)
+    {
+        m_completionCallback = callback;
+    }
+
+    // Get the id of the last request sent (or queued), to match its completion
+    // return:
+    //   the id of the request, 0 if it was not sent
+    inline uint32_t getLastRequestId()
+    {
+        return m_lastRequestId;
+    }
+
     // Set the default text formatting option (https://core.telegram.org/bots/api#formatting-options)
     // params:
     //    format: the type of formatting text of sent messages. No formatting, HTML style (default), MarkdownV2 style
@@ -483,6 +798,7 @@ private:
     TelegramSecureClient *secureTelegramClient = nullptr;
 #endif
     const char *m_token;
+    String m_requestPrefix;
     String m_rxbuffer;
     String m_botusername; // Store only botname, instead TBUser struct
 
@@ -491,22 +807,78 @@ private:
     uint32_t m_minUpdateTime = MIN_UPDATE_TIME;
 
     uint32_t m_lastmsg_timestamp;
-    bool m_waitingReply;
+    // Connection used for updates, and for all the requests if not set otherwise
+    TelegramConnection m_main;
+    TelegramConnection *m_connections[TrafficClassCount] = {&m_main, &m_main, &m_main};
+    bool m_streamParsing = false;
+    bool m_updateFilterEnabled = true;
+    bool m_unknownUpdates = false;
+#if !TELEGRAM_SAX_PARSER
+  #if ARDUINOJSON_VERSION_MAJOR > 6
+    JsonDocument m_updateFilter;
+  #else
+    // Pool as big as the fields in the filter (see initUpdateFilter())
+    DynamicJsonDocument m_updateFilter{0};
+  #endif
+#endif
+    ReceiveBuffer m_rx;
+    uint32_t m_allowedUpdates = 0;
+    bool m_allowedUpdatesSent = true;
+    bool m_pollReply = false;
+    uint16_t m_longPollTimeout = 0;
+
+    // Local queue of updates received with last getUpdates request
+#if TELEGRAM_SAX_PARSER
+    // updates are already decoded, strings in m_arena
+    TBCompactMessage m_updatesQueue[MAX_UPDATES_QUEUE];
+#else
+    // updates point in m_updatesDoc, which is kept until all of them were read
+    TBLazyMessage m_updatesQueue[MAX_UPDATES_QUEUE];
+  #if ARDUINOJSON_VERSION_MAJOR > 6
+    JsonDocument m_updatesDoc;
+  #else
+    DynamicJsonDocument m_updatesDoc{BUFFER_BIG};
+  #endif
+#endif
+    MessageArena m_arena;
+    uint8_t m_updatesLimit = 1;
+    uint8_t m_queueHead = 0;
+    uint8_t m_queueCount = 0;
 
-    InlineKeyboard *m_keyboards[10];
-    uint8_t m_keyboardCount = 0;
+    CallbackTable m_queryCallbacks;
+    CommandRouter *m_router = nullptr;
+    SendQueue *m_sendQueue = nullptr;
 
     void setformData(int64_t chat_id, const char *cmd, const char *type, const char *propName, size_t size,
         String &formData, String &request, const char *filename, const char *caption);
     bool sendStream(int64_t chat_id, const char *command, const char *contentType, const char *binaryPropertyName,
-        Stream &stream, size_t size, const char *filename, const char *caption);
+        Stream &stream, size_t size, const char *filename, const char *caption, bool wait = false);
     bool sendBuffer(int64_t chat_id, const char *cmd, const char *type, const char *propName, uint8_t *data, size_t size, const char *caption);
+    bool startUpload(int64_t chat_id, const char *cmd, const char *type, const char *propName,
+        Stream *stream, const uint8_t *data, size_t size, const char *filename, const char *caption, bool wait);
+    void runUpload();
+    void finishUpload();
+
+    Upload m_upload;
+    TelegramConnection *m_uploadConn = nullptr;
+    uint32_t m_uploadId = 0;
+    bool m_asyncUpload = false;
+
+    TBResult m_result;
+    uint32_t m_replyId = 0;
+    uint32_t m_requestId = 0;
+    uint32_t m_lastRequestId = 0;
+    uint32_t m_sentRequestId = 0;
+    CompletionCallback m_completionCallback = nullptr;
+    DownloadCallback m_downloadCallback = nullptr;
+    uint32_t m_floodTime = 0;
+    uint32_t m_floodDelay = 0;
+    uint32_t m_pollBackoff = 0;
 
     SentCallback m_sentCallback = nullptr;
     bool m_waitSent = false;
     uint32_t m_sentTimeout;
     uint32_t m_lastSentTime;
-    uint32_t m_lastSentMsgId;
 
     uint32_t testReconnectTime;
 
@@ -517,9 +889,51 @@ private:
     bool m_customRecoveryMode = false;
     ConnectionMode m_connectionMode = ConnectionModeCertificateValidation;
     ConnectionRecoveryCallback m_connectionRecoveryCallback = nullptr;
+    const char *m_host = TELEGRAM_HOST;
+    uint16_t m_port = TELEGRAM_PORT;
+    TLSSessionCache *m_sessionCache = nullptr;
+    TLSSession *m_tlsSession = nullptr;
+    bool m_sessionLoaded = false;
+    TBHandshakeStats m_handshakeStats;
+#if defined(ESP8266)
+    BearSSLSession m_bearSSLSession;
+#endif
 
     void initClient(Client &client, uint32_t bufferSize);
-    bool connectToTelegramServer();
+#if !TELEGRAM_SAX_PARSER
+    void initUpdateFilter();
+#endif
+    bool readUpdates(int64_t chatId);
+    void runCallbacks(const TBMessage &message);
+    template <typename Message>
+    void runCallbacks(const Message &message, const char *text);
+    bool checkConnection(TelegramConnection &conn);
+    bool connectToTelegramServer(Client &client);
+    bool connectClient(Client &client);
+    uint16_t longPollTimeout() const;
+    void pollResult(bool ok, uint32_t retryAfter = 0);
+    void skipReply(TelegramConnection &conn);
+    void readReplies(TelegramConnection &conn);
+    void reportLost(TelegramConnection &conn, const char *description = "Connection closed");
+    void failRequest(uint32_t id, const char *description);
+    uint32_t newRequestId();
+    // The payload of a request is either JSON text or a document (when text is nullptr)
+    bool sendPayload(const char *command, const char *text, JsonVariantConst json, bool blocking);
+    bool sendRequest(const char *command, const char *text, JsonVariantConst json, bool blocking, uint32_t id);
+    TelegramConnection *writeRequest(const char *command, const char *text, JsonVariantConst json, uint32_t id);
+    void sendQueued();
+    void endRequest(const TelegramConnection::Request &request, const TBResult &result);
+    size_t printAllowedUpdates(char *buffer, size_t size);
+    bool readHeaders(TelegramConnection &conn);
+    bool readBody(TelegramConnection &conn);
+    bool bodyBuffered();
+    bool waitResponse(TelegramConnection &conn);
+    void endResponse(TelegramConnection &conn);
+    String &replyBuffer(TelegramConnection &conn);
+    DeserializationError deserializeResponse(JsonDocument &doc);
+#if TELEGRAM_SAX_PARSER
+    void decodeResponse();
+#endif
 #if defined(ESP32) || defined(ESP8266)
     bool enableInsecureMode();
 #endif
@@ -535,6 +949,9 @@ protected:
 
     bool sendCommand(const char *command, const char *payload, bool blocking = false);
 
+    // Same as above, but the document is serialized straight to the client
+    bool sendCommand(const char *command, const JsonDocument &payload, bool blocking = false);
+
     // query server for new incoming messages
     // returns
     //   http response payload if no error occurred
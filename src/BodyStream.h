@@ -0,0 +1,203 @@
+#ifndef BODY_STREAM
+#define BODY_STREAM
+
+#include "ReceiveBuffer.h"
+
+/*
+    Read-only Stream that gives access to the body of an HTTP response directly
+    from the receive buffer, limited to the Content-Length declared in the headers
+    or decoding "Transfer-Encoding: chunked" on the fly.
+    It can be passed to deserializeJson() in order to avoid a copy of the raw body.
+*/
+class BodyStream : public Stream
+{
+public:
+  // Body with Content-Length
+  inline void begin(ReceiveBuffer *source, uint32_t length)
+  {
+    m_source = source;
+    m_remaining = length;
+    m_state = length ? ChunkData : BodyDone;
+    m_chunked = false;
+  }
+
+  // Body with chunked transfer encoding
+  inline void beginChunked(ReceiveBuffer *source)
+  {
+    m_source = source;
+    m_remaining = 0;
+    m_state = ChunkSize;
+    m_chunked = true;
+  }
+
+  inline bool chunked() const
+  {
+    return m_chunked;
+  }
+
+  // True when the whole body was read
+  inline bool finished() const
+  {
+    return m_state == BodyDone;
+  }
+
+  // True when the rest of the body is already in the receive buffer (bytes that
+  // follow it, i.e. a pipelined reply, are not counted). Chunk sizes are followed
+  // through the buffered bytes, which are not consumed.
+  bool buffered()
+  {
+    if (m_source == nullptr || m_state == BodyDone)
+      return true;
+    size_t len = m_source->size();
+    if (!m_chunked)
+      return len >= m_remaining;
+
+    const uint8_t *data = m_source->data(len);
+    State state = m_state;
+    uint32_t remaining = m_remaining;
+    for (size_t i = 0; i < len && state != BodyDone;)
+    {
+      if (state != ChunkData)
+      {
+        state = frame(state, remaining, data[i++]);
+        continue;
+      }
+      size_t chunk = len - i < remaining ? len - i : remaining;
+      i += chunk;
+      remaining -= chunk;
+      if (remaining == 0)
+        state = ChunkEnd;
+    }
+    return state == BodyDone;
+  }
+
+  int available() override
+  {
+    if (!nextData())
+      return 0;
+    int avail = m_source->available();
+    return (uint32_t)avail > m_remaining ? m_remaining : avail;
+  }
+
+  int read() override
+  {
+    if (!nextData())
+      return -1;
+    int c = m_source->read();
+    if (c >= 0)
+      consumed(1);
+    return c;
+  }
+
+  // Bulk read of body bytes (only available data, it doesn't wait)
+  int read(uint8_t *buffer, size_t len)
+  {
+    size_t total = 0;
+    while (total < len && nextData())
+    {
+      size_t chunk = len - total;
+      if (chunk > m_remaining)
+        chunk = m_remaining;
+      int n = m_source->read(buffer + total, chunk);
+      if (n <= 0)
+        break;
+      consumed(n);
+      total += n;
+    }
+    return total;
+  }
+
+  int peek() override
+  {
+    if (!nextData())
+      return -1;
+    return m_source->peek();
+  }
+
+  // Discard the remaining part of body (with timeout)
+  void drain(uint32_t timeout)
+  {
+    uint8_t buffer[64];
+    for (uint32_t start = millis(); !finished() && millis() - start < timeout;)
+    {
+      if (read(buffer, sizeof(buffer)) == 0)
+        yield();
+    }
+    m_remaining = 0;
+    m_state = BodyDone;
+  }
+
+  // This is a read-only stream
+  size_t write(uint8_t) override
+  {
+    return 0;
+  }
+
+private:
+  enum State : uint8_t { ChunkSize, ChunkExtension, ChunkData, ChunkEnd, Trailer, TrailerLine, BodyDone };
+
+  ReceiveBuffer *m_source = nullptr;
+  uint32_t m_remaining = 0;     // bytes of body (or of current chunk) not yet read
+  State    m_state = BodyDone;
+  bool     m_chunked = false;
+
+  inline void consumed(size_t len)
+  {
+    m_remaining -= len;
+    if (m_remaining == 0)
+      m_state = m_chunked ? ChunkEnd : BodyDone;
+  }
+
+  // Consume the chunk framing available in source, until some data can be read.
+  // The state is kept between calls, so framing can arrive split in more reads.
+  // returns: true if there are data bytes to read
+  bool nextData()
+  {
+    if (m_source == nullptr)
+      return false;
+    while (m_state != ChunkData)
+    {
+      if (m_state == BodyDone)
+        return false;
+      int c = m_source->read();
+      if (c < 0)
+        return false;
+      m_state = frame(m_state, m_remaining, c);
+    }
+    return true;
+  }
+
+  // Next state of the chunk framing after byte c (remaining is the chunk size)
+  static State frame(State state, uint32_t &remaining, uint8_t c)
+  {
+    switch (state)
+    {
+      case ChunkSize:
+        if (isxdigit(c))
+        {
+          remaining = (remaining << 4) | (isdigit(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+          return state;
+        }
+        // fall through
+      case ChunkExtension:
+        // Chunk extensions are ignored until the end of line
+        if (c == '\n')
+          return remaining ? ChunkData : Trailer;
+        return ChunkExtension;
+      case ChunkEnd:
+        // CRLF after chunk data
+        return c == '\n' ? ChunkSize : state;
+      case Trailer:
+        // Trailer fields end with an empty line
+        if (c == '\n')
+          return BodyDone;
+        return c != '\r' ? TrailerLine : state;
+      case TrailerLine:
+        return c == '\n' ? Trailer : state;
+      default:
+        return state;
+    }
+  }
+};
+
+#endif
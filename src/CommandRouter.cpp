@@ -0,0 +1,86 @@
+#include "CommandRouter.h"
+
+bool CommandRouter::addCommand(const char *command, CommandCallback callback)
+{
+  if (command == nullptr || callback == nullptr)
+    return false;
+  if (*command == '/')
+    command++;
+  if (*command == '\0')
+    return false;
+
+  uint8_t node = 0;
+  for (; *command; command++) {
+    char key = tolower(*command);
+    uint8_t child = m_nodes[node].child;
+    while (child && m_nodes[child].key != key)
+      child = m_nodes[child].next;
+
+    if (child == 0) {
+      if (m_nodesCount == COMMAND_ROUTER_NODES)
+        return false;
+      child = m_nodesCount++;
+      m_nodes[child].key = key;
+      m_nodes[child].next = m_nodes[node].child;
+      m_nodes[node].child = child;
+    }
+    node = child;
+  }
+
+  if (m_nodes[node].command == 0) {
+    if (m_commandsCount == COMMAND_ROUTER_COMMANDS)
+      return false;
+    m_nodes[node].command = ++m_commandsCount;
+  }
+  m_callbacks[m_nodes[node].command - 1] = callback;
+  return true;
+}
+
+CommandRouter::CommandCallback CommandRouter::find(const char *text, const char *botName,
+                                                   const char *&args, size_t &length) const
+{
+  if (text == nullptr || *text != '/')
+    return nullptr;
+
+  // Walk the trie while reading the command
+  uint8_t node = 0;
+  const char *p = text + 1;
+  for (; *p && *p != ' ' && *p != '@' && *p != '\n'; p++) {
+    char key = tolower(*p);
+    uint8_t child = m_nodes[node].child;
+    while (child && m_nodes[child].key != key)
+      child = m_nodes[child].next;
+    if (child == 0)
+      return nullptr;
+    node = child;
+  }
+  if (m_nodes[node].command == 0)
+    return nullptr;
+
+  if (*p == '@') {
+    // The command is addressed to a bot (i.e. in groups): check if it's this one
+    const char *name = ++p;
+    while (*p && *p != ' ' && *p != '\n')
+      p++;
+    size_t len = p - name;
+    if (botName != nullptr && *botName && (strlen(botName) != len || strncasecmp(name, botName, len) != 0))
+      return nullptr;
+  }
+
+  while (*p == ' ' || *p == '\n')
+    p++;
+  args = p;
+  length = strlen(p);
+  return m_callbacks[m_nodes[node].command - 1];
+}
+
+bool CommandRouter::dispatch(const TBMessage &msg, const char *botName) const
+{
+  const char *args;
+  size_t length;
+  CommandCallback callback = find(msg.text.c_str(), botName, args, length);
+  if (callback == nullptr)
+    return false;
+  callback(msg, args, length);
+  return true;
+}
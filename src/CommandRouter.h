@@ -0,0 +1,70 @@
+#ifndef COMMAND_ROUTER
+#define COMMAND_ROUTER
+
+#include <Arduino.h>
+#include "DataStructures.h"
+
+// Max number of commands and of trie nodes (one for each distinct command prefix)
+#ifndef COMMAND_ROUTER_COMMANDS
+#define COMMAND_ROUTER_COMMANDS 16
+#endif
+#ifndef COMMAND_ROUTER_NODES
+#define COMMAND_ROUTER_NODES 96
+#endif
+#if COMMAND_ROUTER_NODES > 255 || COMMAND_ROUTER_COMMANDS > 255
+#error "COMMAND_ROUTER_NODES and COMMAND_ROUTER_COMMANDS must be less than 256"
+#endif
+
+/*
+    Dispatch bot commands ("/cmd arguments") to the registered handlers.
+    Commands are stored in a static trie, so a message is matched reading its
+    command once, whatever the number of commands. Matching is case insensitive
+    and the "@botname" suffix is accepted only with the name of this bot.
+    Handlers get the arguments as a pointer in the text of message (no copy).
+*/
+class CommandRouter
+{
+public:
+  //   msg   : message with the command
+  //   args  : text after the command (spaces skipped), not a copy
+  //   length: length of args
+  typedef void(*CommandCallback)(const TBMessage &msg, const char *args, size_t length);
+
+  // add a command handler (a command already added is replaced)
+  // params:
+  //   command : the command, with or without leading '/' (i.e. "/start")
+  //   callback: the function called when the command is received
+  // return:
+  //    false if there is no more room for the command
+  bool addCommand(const char *command, CommandCallback callback);
+
+  // find the handler of the command at the beginning of text
+  // params:
+  //   text   : text of message
+  //   botName: username of the bot (without '@'), empty to accept any name
+  //   args   : set to the arguments of command
+  //   length : set to the length of arguments
+  // return:
+  //    the handler of command, nullptr if text is not a registered command
+  CommandCallback find(const char *text, const char *botName, const char *&args, size_t &length) const;
+
+  // call the handler of the command contained in msg.text (if any)
+  // return:
+  //    true if a handler was called
+  bool dispatch(const TBMessage &msg, const char *botName) const;
+
+private:
+  struct Node {
+    char    key;
+    uint8_t child;      // first child (0 = leaf)
+    uint8_t next;       // next sibling (0 = last)
+    uint8_t command;    // 1 based index of handler (0 = prefix only)
+  };
+
+  Node            m_nodes[COMMAND_ROUTER_NODES] = {};
+  CommandCallback m_callbacks[COMMAND_ROUTER_COMMANDS] = {};
+  uint8_t         m_nodesCount = 1;     // node 0 is the root
+  uint8_t         m_commandsCount = 0;
+};
+
+#endif
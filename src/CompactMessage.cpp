@@ -0,0 +1,123 @@
+#include "CompactMessage.h"
+
+// Offsets are 16 bit wide
+#define MAX_ARENA_SIZE 0xFFFF
+
+bool MessageArena::reserve(size_t size)
+{
+  if (m_length + size <= m_capacity)
+    return true;
+
+  size_t capacity = m_capacity ? m_capacity : MESSAGE_ARENA_SIZE;
+  while (capacity < m_length + size && capacity < MAX_ARENA_SIZE)
+    capacity *= 2;
+  if (capacity > MAX_ARENA_SIZE)
+    capacity = MAX_ARENA_SIZE;
+  if (capacity <= m_capacity)
+    return false;
+
+  char *buffer = (char *)realloc(m_buffer, capacity);
+  if (buffer == nullptr)
+    return false;
+  m_buffer = buffer;
+  m_capacity = capacity;
+  return m_length + size <= m_capacity;
+}
+
+uint16_t MessageArena::begin()
+{
+  m_start = 0;
+  // First byte is the empty string at offset 0
+  if (m_length == 0) {
+    if (!reserve(1))
+      return 0;
+    m_buffer[m_length++] = '\0';
+  }
+  if (reserve(1))
+    m_start = m_length;
+  return m_start;
+}
+
+void MessageArena::append(const char *str, size_t len)
+{
+  if (m_start == 0 || len == 0)
+    return;
+  // Keep room for the null terminator, truncate if there is no more memory
+  if (!reserve(len + 1))
+    len = m_capacity - m_length - 1;
+  memcpy(m_buffer + m_length, str, len);
+  m_length += len;
+}
+
+void MessageArena::end()
+{
+  if (m_start == 0)
+    return;
+  m_buffer[m_length++] = '\0';
+  m_start = 0;
+}
+
+uint16_t MessageArena::add(const char *str)
+{
+  if (str == nullptr || *str == '\0')
+    return 0;
+  uint16_t offset = begin();
+  append(str, strlen(str));
+  end();
+  return offset;
+}
+
+void TBCompactMessage::clear(const MessageArena *strings)
+{
+  memset(this, 0, sizeof(TBCompactMessage));
+  messageType = MessageNoData;
+  arena = strings;
+}
+
+void TBCompactMessage::copyTo(TBMessage &message) const
+{
+  // Strings are assigned also when empty, so their buffers are reused
+  message.messageType = messageType;
+  message.isHTMLenabled = true;
+  message.isMarkdownEnabled = false;
+  message.disable_notification = false;
+  message.force_reply = false;
+  message.date = date;
+  message.chatId = chatId;
+  message.messageID = messageID;
+  message.sender.isBot = false;
+  message.sender.id = senderId;
+  message.sender.username = c_str(senderUsername);
+  message.sender.firstName = c_str(senderFirstName);
+  message.sender.lastName = c_str(senderLastName);
+  message.text = c_str(text);
+
+  message.chatInstance = messageType == MessageQuery ? query.chatInstance : 0;
+  message.callbackQueryID = messageType == MessageQuery ? query.id : 0;
+  message.callbackQueryData = messageType == MessageQuery ? c_str(query.data) : "";
+
+  bool isLocation = messageType == MessageLocation;
+  message.location.longitude = isLocation ? location.longitude : 0;
+  message.location.latitude = isLocation ? location.latitude : 0;
+
+  bool isContact = messageType == MessageContact;
+  message.contact.id = isContact ? contact.id : 0;
+  message.contact.phoneNumber = isContact ? c_str(contact.phoneNumber) : "";
+  message.contact.firstName = isContact ? c_str(contact.firstName) : "";
+  message.contact.lastName = isContact ? c_str(contact.lastName) : "";
+  message.contact.vCard = isContact ? c_str(contact.vCard) : "";
+
+  bool isMember = messageType == MessageNewMember || messageType == MessageLeftMember;
+  message.member.isBot = isMember ? member.isBot : false;
+  message.member.id = isMember ? member.id : 0;
+  message.member.firstName = isMember ? c_str(member.firstName) : "";
+  message.member.lastName = isMember ? c_str(member.lastName) : "";
+  message.member.username = isMember ? c_str(member.username) : "";
+
+  bool isDocument = messageType == MessageDocument;
+  message.document.file_exists = isDocument ? document.fileExists : false;
+  message.document.file_size = isDocument ? document.fileSize : 0;
+  message.document.file_id = isDocument ? c_str(document.fileId) : "";
+  message.document.file_name = isDocument ? c_str(document.fileName) : "";
+  message.document.file_path = isDocument ? c_str(document.filePath) : "";
+}
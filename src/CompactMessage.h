@@ -0,0 +1,124 @@
+#ifndef COMPACT_MESSAGE
+#define COMPACT_MESSAGE
+
+#include <Arduino.h>
+#include "DataStructures.h"
+
+/*
+    Initial size of the strings arena of the updates queue. The arena grows
+    (doubling its size) when a batch of updates doesn't fit, and it's never
+    shrinked, so after the first batches no more heap allocations are done.
+*/
+#ifndef MESSAGE_ARENA_SIZE
+#define MESSAGE_ARENA_SIZE 256
+#endif
+
+/*
+    Growable buffer of null terminated strings, addressed by 16 bit offsets.
+    Offset 0 is always the empty string. All strings are discarded together
+    with clear(), but the allocated memory is kept for next use.
+*/
+class MessageArena
+{
+public:
+  MessageArena() {}
+  MessageArena(const MessageArena &) = delete;
+  MessageArena &operator=(const MessageArena &) = delete;
+  ~MessageArena() { free(m_buffer); }
+
+  inline void clear() { m_length = 0; }
+
+  inline const char *get(uint16_t offset) const
+  {
+    return offset ? m_buffer + offset : "";
+  }
+
+  // Copy a string in the arena (strings too long for the arena are truncated)
+  // returns: offset of the new string
+  uint16_t add(const char *str);
+
+  // Write a string in more steps: begin(), append() any times, end()
+  uint16_t begin();
+  void append(const char *str, size_t len);
+  void end();
+
+  // Memory allocated by the arena
+  inline size_t capacity() const { return m_capacity; }
+
+private:
+  char    *m_buffer = nullptr;
+  size_t   m_capacity = 0;
+  size_t   m_length = 0;
+  uint16_t m_start = 0;
+
+  bool reserve(size_t size);
+};
+
+/*
+    Heap-light alternative to TBMessage. Only the fields of the actual message
+    type are stored (tagged union keyed by messageType), and strings are offsets
+    in the arena of the updates queue. Use c_str() to read a string field:
+        Serial.println(msg.c_str(msg.text));
+    String fields are valid until the next call of getNewMessage().
+*/
+struct TBCompactMessage {
+  MessageType messageType;
+  int32_t     date;
+  int32_t     messageID;
+  int64_t     chatId;
+  int64_t     senderId;
+  uint16_t    senderUsername;
+  uint16_t    senderFirstName;
+  uint16_t    senderLastName;
+  uint16_t    text;
+  union {
+    // MessageQuery
+    struct {
+      int64_t  id;
+      int32_t  chatInstance;
+      uint16_t data;
+    } query;
+    // MessageLocation
+    TBLocation location;
+    // MessageContact
+    struct {
+      int64_t  id;
+      uint16_t phoneNumber;
+      uint16_t firstName;
+      uint16_t lastName;
+      uint16_t vCard;
+    } contact;
+    // MessageNewMember, MessageLeftMember
+    struct {
+      int64_t  id;
+      bool     isBot;
+      uint16_t firstName;
+      uint16_t lastName;
+      uint16_t username;
+    } member;
+    // MessageDocument
+    struct {
+      int32_t  fileSize;
+      bool     fileExists;
+      uint16_t fileId;
+      uint16_t fileName;
+      uint16_t filePath;
+    } document;
+    // MessageUnknown: JSON text of the whole update
+    uint16_t update;
+  };
+  const MessageArena *arena;
+
+  // Reset all fields (strings are set to empty string)
+  void clear(const MessageArena *strings = nullptr);
+
+  inline const char *c_str(uint16_t field) const
+  {
+    return arena != nullptr ? arena->get(field) : "";
+  }
+
+  // Fill a TBMessage with the content of this message
+  void copyTo(TBMessage &message) const;
+};
+
+#endif
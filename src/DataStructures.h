@@ -16,7 +16,8 @@ enum MessageType {
   MessageReply 	  = 6,
   MessageNewMember = 7,
   MessageLeftMember =8,
-  MessageForwarded = 9
+  MessageForwarded = 9,
+  MessageUnknown  = 10
 };
 
 struct TBUser {
@@ -68,5 +69,26 @@ struct TBMessage {
   String      	text;
 };
 
+// Result of a request to Telegram server
+struct TBResult {
+  bool          ok = false;
+  uint32_t      requestId = 0;    // see AsyncTelegram2::getLastRequestId()
+  int32_t       messageId = 0;    // "message_id" of the message sent or edited
+  uint16_t      httpStatus = 0;   // i.e. 200, 429
+  int32_t       errorCode = 0;    // "error_code" of Telegram (0 when ok)
+  uint32_t      retryAfter = 0;   // seconds to wait before sending again (flood control)
+  String        description;
+};
+
+// TLS handshakes made with Telegram server (see AsyncTelegram2::getHandshakeStats())
+struct TBHandshakeStats {
+  uint32_t      handshakes = 0;   // connections opened
+  uint32_t      resumed = 0;      // of which with a resumed TLS session
+  uint32_t      failed = 0;       // connection attempts failed
+  uint32_t      lastTime = 0;     // ms taken by last handshake
+  uint32_t      totalTime = 0;    // ms taken by all the handshakes
+  uint32_t      resumedTime = 0;  // ms taken by the resumed ones
+};
+
 #endif
 
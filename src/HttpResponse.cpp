@@ -0,0 +1,67 @@
+#include "HttpResponse.h"
+
+void HttpResponse::begin()
+{
+  m_state = StatusLine;
+  m_status = 0;
+  m_contentLength = 0;
+  m_retryAfter = 0;
+  m_chunked = false;
+  m_close = false;
+  m_length = 0;
+}
+
+HttpResponse::State HttpResponse::parse(ReceiveBuffer &source)
+{
+  while (m_state == StatusLine || m_state == Headers)
+  {
+    int c = source.read();
+    if (c < 0)
+      break;
+
+    if (c != '\n')
+    {
+      if (m_length < sizeof(m_line) - 1)
+        m_line[m_length++] = c;
+      continue;
+    }
+
+    if (m_length && m_line[m_length - 1] == '\r')
+      m_length--;
+    m_line[m_length] = '\0';
+    parseLine();
+    m_length = 0;
+  }
+  return m_state;
+}
+
+void HttpResponse::parseLine()
+{
+  if (m_state == StatusLine)
+  {
+    // Skip empty lines left before the status line
+    if (m_length == 0)
+      return;
+    if (strncmp(m_line, "HTTP/1.", 7) != 0)
+    {
+      m_state = Error;
+      return;
+    }
+    // HTTP/1.0 servers close the connection by default
+    m_close = m_line[7] == '0';
+    m_status = m_length > 9 ? atoi(m_line + 9) : 0;
+    m_state = Headers;
+  }
+  // An empty line marks the end of headers
+  else if (m_length == 0)
+    m_state = Body;
+  else if (strncasecmp(m_line, "Content-Length:", 15) == 0)
+    m_contentLength = strtoul(m_line + 15, nullptr, 10);
+  else if (strncasecmp(m_line, "Transfer-Encoding:", 18) == 0)
+    m_chunked = strstr(m_line + 18, "chunked") != nullptr;
+  else if (strncasecmp(m_line, "Connection:", 11) == 0)
+    m_close = strstr(m_line + 11, "close") != nullptr;
+  // Only delay in seconds is supported (not HTTP date)
+  else if (strncasecmp(m_line, "Retry-After:", 12) == 0)
+    m_retryAfter = strtoul(m_line + 12, nullptr, 10);
+}
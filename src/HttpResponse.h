@@ -0,0 +1,77 @@
+#ifndef HTTP_RESPONSE
+#define HTTP_RESPONSE
+
+#include "ReceiveBuffer.h"
+
+/*
+    Incremental parser of HTTP response headers.
+    parse() consumes only the bytes already received and then returns, keeping the
+    partial line between calls: a reply split in more TLS records is completed with
+    the next calls instead of waiting for it.
+*/
+class HttpResponse
+{
+public:
+  enum State : uint8_t { StatusLine, Headers, Body, Error };
+
+  // Prepare for a new response
+  void begin();
+
+  // Parse the headers available in source (it doesn't wait)
+  // returns: Body when all headers were read, Error if reply is not HTTP
+  State parse(ReceiveBuffer &source);
+
+  inline State state() const
+  {
+    return m_state;
+  }
+
+  inline bool headersDone() const
+  {
+    return m_state == Body;
+  }
+
+  // HTTP status code (i.e. 200, 429)
+  inline uint16_t status() const
+  {
+    return m_status;
+  }
+
+  inline uint32_t contentLength() const
+  {
+    return m_contentLength;
+  }
+
+  inline bool chunked() const
+  {
+    return m_chunked;
+  }
+
+  // Server will close the connection after this response
+  inline bool closeConnection() const
+  {
+    return m_close;
+  }
+
+  // Seconds to wait before a new request (Retry-After header, 0 if missing)
+  inline uint32_t retryAfter() const
+  {
+    return m_retryAfter;
+  }
+
+private:
+  State    m_state = StatusLine;
+  uint16_t m_status = 0;
+  uint32_t m_contentLength = 0;
+  uint32_t m_retryAfter = 0;
+  bool     m_chunked = false;
+  bool     m_close = false;
+
+  // Line being received (characters that doesn't fit are discarded)
+  char     m_line[128];
+  uint8_t  m_length = 0;
+
+  void parseLine();
+};
+
+#endif
@@ -59,6 +59,8 @@ bool InlineKeyboard::addButton(const char* text, const char* command, InlineKeyb
   inlineButton->btnName = (char*)command;
   _lastButton = inlineButton;
   m_buttonsCounter++;
+  if (m_callbacks != nullptr && onClick != nullptr)
+    m_callbacks->add(command, onClick);
 
   JSON_DOC(m_jsonSize);
   DeserializationError error = deserializeJson(root, m_json);
@@ -90,13 +92,76 @@ bool InlineKeyboard::addButton(const char* text, const char* command, InlineKeyb
   return true;
 }
 
-// Check if a callback function has to be called for this button query message
-void InlineKeyboard::checkCallback( const TBMessage &msg)  {
-  for(InlineButton *_button = _firstButton; _button != nullptr; _button = _button->nextButton){
-    if( msg.callbackQueryData.equals(_button->btnName) && _button->argCallback != nullptr){
-      _button->argCallback(msg);
-    }
+// FNV-1a hash
+uint32_t CallbackTable::hash(const char *str)
+{
+  uint32_t hash = 2166136261UL;
+  while (*str)
+    hash = (hash ^ (uint8_t)*str++) * 16777619UL;
+  return hash;
+}
+
+bool CallbackTable::grow()
+{
+  size_t capacity = m_capacity ? m_capacity * 2 : CALLBACK_TABLE_SIZE;
+  Entry *entries = (Entry *)calloc(capacity, sizeof(Entry));
+  if (entries == nullptr)
+    return false;
+
+  // Move all entries in the new table
+  for (size_t i = 0; i < m_capacity; i++) {
+    if (m_entries[i].data == nullptr)
+      continue;
+    size_t slot = m_entries[i].hash & (capacity - 1);
+    while (entries[slot].data != nullptr)
+      slot = (slot + 1) & (capacity - 1);
+    entries[slot] = m_entries[i];
+  }
+  free(m_entries);
+  m_entries = entries;
+  m_capacity = capacity;
+  return true;
+}
+
+bool CallbackTable::add(const char *data, CallbackType callback)
+{
+  if (data == nullptr || callback == nullptr)
+    return false;
+  if ((m_count + 1) * 4 > m_capacity * 3 && !grow())
+    return false;
+
+  // Linear probing: the same data can be added more times (all callbacks are called)
+  uint32_t h = hash(data);
+  size_t slot = h & (m_capacity - 1);
+  while (m_entries[slot].data != nullptr)
+    slot = (slot + 1) & (m_capacity - 1);
+  m_entries[slot].hash = h;
+  m_entries[slot].data = data;
+  m_entries[slot].callback = callback;
+  m_count++;
+  return true;
+}
+
+bool CallbackTable::call(const TBMessage &msg) const
+{
+  if (m_count == 0)
+    return false;
+
+  const char *data = msg.callbackQueryData.c_str();
+  uint32_t h = hash(data);
+  bool called = false;
+  for (size_t slot = h & (m_capacity - 1); m_entries[slot].data != nullptr; slot = (slot + 1) & (m_capacity - 1)) {
+    const Entry &entry = m_entries[slot];
+    if (entry.hash != h || strcmp(entry.data, data) != 0)
+      continue;
+    const Entry *entries = m_entries;
+    entry.callback(msg);
+    called = true;
+    // A callback has added new buttons and the table was moved
+    if (entries != m_entries)
+      break;
   }
+  return called;
 }
 
 // Get total number of keyboard buttons
@@ -18,6 +18,54 @@ enum InlineKeyboardButtonType {
   KeyboardButtonQuery  = 2
 };
 
+// Initial number of slots of the callbacks table (power of 2)
+#ifndef CALLBACK_TABLE_SIZE
+#define CALLBACK_TABLE_SIZE 16
+#endif
+
+/*
+    Hash table from the callback data of buttons to their callback functions,
+    shared by all the inline keyboards added to the bot. Callback data of a query
+    is hashed once, so dispatch doesn't depend on the number of keyboards and
+    buttons. The table is doubled when it's 3/4 full.
+*/
+class CallbackTable
+{
+public:
+  typedef void(*CallbackType)(const TBMessage &msg);
+
+  CallbackTable() {}
+  CallbackTable(const CallbackTable &) = delete;
+  CallbackTable &operator=(const CallbackTable &) = delete;
+  ~CallbackTable() { free(m_entries); }
+
+  // add a callback for data (string is not copied, it must be persistent)
+  // return:
+  //    false if there is no memory for a bigger table
+  bool add(const char *data, CallbackType callback);
+
+  // call all the callbacks added for msg.callbackQueryData
+  // return:
+  //    true if at least one callback was called
+  bool call(const TBMessage &msg) const;
+
+  inline size_t size() const { return m_count; }
+
+private:
+  struct Entry {
+    uint32_t     hash;
+    const char  *data;      // nullptr = empty slot
+    CallbackType callback;
+  };
+
+  Entry  *m_entries = nullptr;
+  size_t  m_capacity = 0;
+  size_t  m_count = 0;
+
+  static uint32_t hash(const char *str);
+  bool grow();
+};
+
 
 class InlineKeyboard
 {
@@ -73,8 +121,8 @@ private:
   InlineButton 	*_firstButton = nullptr;
   InlineButton 	*_lastButton = nullptr;
 
-  // Check if a callback function has to be called for a button query reply message
-  void checkCallback(const TBMessage &msg) ;
+  // Table of the bot this keyboard was added to (callbacks of new buttons are added there)
+  CallbackTable *m_callbacks = nullptr;
 
 };
 
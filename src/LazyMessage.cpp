@@ -0,0 +1,396 @@
+#include "AsyncTelegram2.h"
+
+#if TELEGRAM_SAX_PARSER
+
+void TBLazyMessage::begin(const TBCompactMessage &message)
+{
+  m_message = message;
+  messageType = message.messageType;
+}
+
+int64_t TBLazyMessage::chatId() const { return m_message.chatId; }
+int32_t TBLazyMessage::messageID() const { return m_message.messageID; }
+int32_t TBLazyMessage::date() const { return m_message.date; }
+const char *TBLazyMessage::text() const { return m_message.c_str(m_message.text); }
+
+int64_t TBLazyMessage::senderId() const { return m_message.senderId; }
+const char *TBLazyMessage::senderUsername() const { return m_message.c_str(m_message.senderUsername); }
+const char *TBLazyMessage::senderFirstName() const { return m_message.c_str(m_message.senderFirstName); }
+const char *TBLazyMessage::senderLastName() const { return m_message.c_str(m_message.senderLastName); }
+
+int64_t TBLazyMessage::callbackQueryID() const
+{
+  return messageType == MessageQuery ? m_message.query.id : 0;
+}
+
+int32_t TBLazyMessage::chatInstance() const
+{
+  return messageType == MessageQuery ? m_message.query.chatInstance : 0;
+}
+
+const char *TBLazyMessage::callbackQueryData() const
+{
+  return messageType == MessageQuery ? m_message.c_str(m_message.query.data) : "";
+}
+
+TBLocation TBLazyMessage::location() const
+{
+  TBLocation location = {0, 0};
+  if (messageType == MessageLocation)
+    location = m_message.location;
+  return location;
+}
+
+TBContact TBLazyMessage::contact() const
+{
+  TBContact contact;
+  contact.id = 0;
+  if (messageType == MessageContact) {
+    contact.id = m_message.contact.id;
+    contact.phoneNumber = m_message.c_str(m_message.contact.phoneNumber);
+    contact.firstName = m_message.c_str(m_message.contact.firstName);
+    contact.lastName = m_message.c_str(m_message.contact.lastName);
+    contact.vCard = m_message.c_str(m_message.contact.vCard);
+  }
+  return contact;
+}
+
+TBUser TBLazyMessage::member() const
+{
+  TBUser member;
+  member.isBot = false;
+  if (messageType == MessageNewMember || messageType == MessageLeftMember) {
+    member.isBot = m_message.member.isBot;
+    member.id = m_message.member.id;
+    member.firstName = m_message.c_str(m_message.member.firstName);
+    member.lastName = m_message.c_str(m_message.member.lastName);
+    member.username = m_message.c_str(m_message.member.username);
+  }
+  return member;
+}
+
+TBDocument TBLazyMessage::document() const
+{
+  // File path is empty until getFile() is called with the document
+  TBDocument document;
+  document.file_exists = false;
+  document.file_size = 0;
+  if (messageType == MessageDocument) {
+    document.file_exists = m_message.document.fileExists;
+    document.file_size = m_message.document.fileSize;
+    document.file_id = m_message.c_str(m_message.document.fileId);
+    document.file_name = m_message.c_str(m_message.document.fileName);
+    document.file_path = m_message.c_str(m_message.document.filePath);
+  }
+  return document;
+}
+
+const char *TBLazyMessage::rawUpdate() const
+{
+  return messageType == MessageUnknown ? m_message.c_str(m_message.update) : "";
+}
+
+void TBLazyMessage::copyTo(TBMessage &message) const
+{
+  m_message.copyTo(message);
+}
+
+void TBLazyMessage::copyTo(TBCompactMessage &message, MessageArena &) const
+{
+  // Strings are already in the arena of the updates queue
+  message = m_message;
+}
+
+#else
+
+static inline const char *str(JsonVariantConst value)
+{
+  const char *s = value.as<const char *>();
+  return s != nullptr ? s : "";
+}
+
+// Serialize JSON directly in the strings arena
+class ArenaPrint : public Print
+{
+public:
+  ArenaPrint(MessageArena &arena) : m_arena(arena) {}
+  size_t write(uint8_t c) override
+  {
+    m_arena.append((const char *)&c, 1);
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size) override
+  {
+    m_arena.append((const char *)buffer, size);
+    return size;
+  }
+
+private:
+  MessageArena &m_arena;
+};
+
+// Find out the type of the update and where message and sender are
+MessageType TBLazyMessage::begin(JsonVariantConst update, bool unknown)
+{
+  m_update = update;
+  m_message = JsonVariantConst();
+  m_sender = JsonVariantConst();
+  messageType = MessageNoData;
+
+  if (update["callback_query"]["id"]) {
+    // this is a callback query
+    m_message = update["callback_query"]["message"];
+    m_sender = update["callback_query"]["from"];
+    messageType = MessageQuery;
+  }
+  else if (update["forward_from"]) {
+    // this is the reply to a forwardMessage command
+    m_message = update;
+    m_sender = update["forward_from"];
+    messageType = MessageForwarded;
+  }
+  else if (update["channel_post"]) {
+    // this is a channel message
+    m_message = update["channel_post"];
+    m_sender = m_message["sender_chat"];
+    messageType = MessageText;
+  }
+  else if (update["message"]["message_id"]) {
+    m_message = update["message"];
+    m_sender = m_message["from"];
+    if (m_message["location"])
+      messageType = MessageLocation;
+    else if (m_message["contact"])
+      messageType = MessageContact;
+    else if (m_message["new_chat_member"])
+      messageType = MessageNewMember;
+    else if (m_message["left_chat_member"])
+      messageType = MessageLeftMember;
+    else if (m_message["document"])
+      messageType = MessageDocument;
+    else if (m_message["reply_to_message"])
+      messageType = MessageReply;
+    else if (m_message["text"])
+      messageType = MessageText;
+  }
+
+  if (messageType == MessageNoData && unknown && update["update_id"]) {
+    // Other update types have a single object beside update_id: when it's
+    // a message (or a chat member update) the common fields are available
+    messageType = MessageUnknown;
+    if (m_message.isNull()) {
+      for (JsonPairConst member : update.as<JsonObjectConst>()) {
+        if (member.value().is<JsonObjectConst>()) {
+          m_message = member.value();
+          break;
+        }
+      }
+    }
+    m_sender = m_message["from"];
+  }
+  return messageType;
+}
+
+int64_t TBLazyMessage::chatId() const { return m_message["chat"]["id"]; }
+int32_t TBLazyMessage::messageID() const { return m_message["message_id"]; }
+int32_t TBLazyMessage::date() const { return m_message["date"]; }
+
+const char *TBLazyMessage::text() const
+{
+  return str(m_message[messageType == MessageDocument ? "caption" : "text"]);
+}
+
+int64_t TBLazyMessage::senderId() const { return m_sender["id"]; }
+
+const char *TBLazyMessage::senderUsername() const
+{
+  // Channels have a title instead of username
+  if (m_sender["title"])
+    return str(m_sender["title"]);
+  return str(m_sender["username"]);
+}
+
+const char *TBLazyMessage::senderFirstName() const { return str(m_sender["first_name"]); }
+const char *TBLazyMessage::senderLastName() const { return str(m_sender["last_name"]); }
+
+int64_t TBLazyMessage::callbackQueryID() const
+{
+  return messageType == MessageQuery ? m_update["callback_query"]["id"].as<int64_t>() : 0;
+}
+
+int32_t TBLazyMessage::chatInstance() const
+{
+  return messageType == MessageQuery ? m_update["callback_query"]["chat_instance"].as<int32_t>() : 0;
+}
+
+const char *TBLazyMessage::callbackQueryData() const
+{
+  return messageType == MessageQuery ? str(m_update["callback_query"]["data"]) : "";
+}
+
+TBLocation TBLazyMessage::location() const
+{
+  TBLocation location = {0, 0};
+  if (messageType == MessageLocation) {
+    location.longitude = m_message["location"]["longitude"];
+    location.latitude = m_message["location"]["latitude"];
+  }
+  return location;
+}
+
+TBContact TBLazyMessage::contact() const
+{
+  TBContact contact;
+  contact.id = 0;
+  if (messageType == MessageContact) {
+    JsonVariantConst data = m_message["contact"];
+    contact.id = data["user_id"];
+    contact.phoneNumber = str(data["phone_number"]);
+    contact.firstName = str(data["first_name"]);
+    contact.lastName = str(data["last_name"]);
+    contact.vCard = str(data["vcard"]);
+  }
+  return contact;
+}
+
+TBUser TBLazyMessage::member() const
+{
+  TBUser member;
+  member.isBot = false;
+  if (messageType == MessageNewMember || messageType == MessageLeftMember) {
+    JsonVariantConst data = m_message[messageType == MessageNewMember ? "new_chat_member" : "left_chat_member"];
+    member.isBot = data["is_bot"];
+    member.id = data["id"];
+    member.firstName = str(data["first_name"]);
+    member.lastName = str(data["last_name"]);
+    member.username = str(data["username"]);
+  }
+  return member;
+}
+
+TBDocument TBLazyMessage::document() const
+{
+  TBDocument document;
+  document.file_exists = false;
+  document.file_size = 0;
+  if (messageType == MessageDocument) {
+    // File path is requested only when needed, with getFile()
+    JsonVariantConst data = m_message["document"];
+    document.file_id = str(data["file_id"]);
+    document.file_name = str(data["file_name"]);
+    document.file_size = data["file_size"].as<int32_t>();
+    document.file_exists = document.file_id.length() > 0;
+  }
+  return document;
+}
+
+void TBLazyMessage::copyTo(TBMessage &message) const
+{
+  // Strings are assigned also when empty, so their buffers are reused
+  message.messageType = messageType;
+  message.isHTMLenabled = true;
+  message.isMarkdownEnabled = false;
+  message.disable_notification = false;
+  message.force_reply = false;
+  message.date = date();
+  message.chatId = chatId();
+  message.messageID = messageID();
+  message.sender.isBot = false;
+  message.sender.id = senderId();
+  message.sender.username = senderUsername();
+  message.sender.firstName = senderFirstName();
+  message.sender.lastName = senderLastName();
+  message.text = text();
+
+  message.chatInstance = chatInstance();
+  message.callbackQueryID = callbackQueryID();
+  message.callbackQueryData = callbackQueryData();
+  message.location = location();
+
+  JsonVariantConst data = m_message["contact"];
+  bool isContact = messageType == MessageContact;
+  message.contact.id = isContact ? data["user_id"].as<int64_t>() : 0;
+  message.contact.phoneNumber = isContact ? str(data["phone_number"]) : "";
+  message.contact.firstName = isContact ? str(data["first_name"]) : "";
+  message.contact.lastName = isContact ? str(data["last_name"]) : "";
+  message.contact.vCard = isContact ? str(data["vcard"]) : "";
+
+  data = m_message[messageType == MessageNewMember ? "new_chat_member" : "left_chat_member"];
+  bool isMember = messageType == MessageNewMember || messageType == MessageLeftMember;
+  message.member.isBot = isMember ? data["is_bot"].as<bool>() : false;
+  message.member.id = isMember ? data["id"].as<int64_t>() : 0;
+  message.member.firstName = isMember ? str(data["first_name"]) : "";
+  message.member.lastName = isMember ? str(data["last_name"]) : "";
+  message.member.username = isMember ? str(data["username"]) : "";
+
+  data = m_message["document"];
+  bool isDocument = messageType == MessageDocument;
+  message.document.file_id = isDocument ? str(data["file_id"]) : "";
+  message.document.file_name = isDocument ? str(data["file_name"]) : "";
+  message.document.file_path = "";
+  message.document.file_size = isDocument ? data["file_size"].as<int32_t>() : 0;
+  message.document.file_exists = isDocument && message.document.file_id.length() > 0;
+}
+
+void TBLazyMessage::copyTo(TBCompactMessage &message, MessageArena &arena) const
+{
+  message.clear(&arena);
+  message.messageType = messageType;
+  message.date = date();
+  message.chatId = chatId();
+  message.messageID = messageID();
+  message.senderId = senderId();
+  message.senderUsername = arena.add(senderUsername());
+  message.senderFirstName = arena.add(senderFirstName());
+  message.senderLastName = arena.add(senderLastName());
+  message.text = arena.add(text());
+
+  JsonVariantConst data;
+  switch (messageType) {
+    case MessageQuery:
+      message.query.id = callbackQueryID();
+      message.query.chatInstance = chatInstance();
+      message.query.data = arena.add(callbackQueryData());
+      break;
+    case MessageLocation:
+      message.location = location();
+      break;
+    case MessageContact:
+      data = m_message["contact"];
+      message.contact.id = data["user_id"];
+      message.contact.phoneNumber = arena.add(str(data["phone_number"]));
+      message.contact.firstName = arena.add(str(data["first_name"]));
+      message.contact.lastName = arena.add(str(data["last_name"]));
+      message.contact.vCard = arena.add(str(data["vcard"]));
+      break;
+    case MessageNewMember:
+    case MessageLeftMember:
+      data = m_message[messageType == MessageNewMember ? "new_chat_member" : "left_chat_member"];
+      message.member.isBot = data["is_bot"];
+      message.member.id = data["id"];
+      message.member.firstName = arena.add(str(data["first_name"]));
+      message.member.lastName = arena.add(str(data["last_name"]));
+      message.member.username = arena.add(str(data["username"]));
+      break;
+    case MessageDocument: {
+      TBDocument file = document();
+      message.document.fileExists = file.file_exists;
+      message.document.fileSize = file.file_size;
+      message.document.fileId = arena.add(file.file_id.c_str());
+      message.document.fileName = arena.add(file.file_name.c_str());
+      message.document.filePath = arena.add(file.file_path.c_str());
+      break;
+    }
+    case MessageUnknown: {
+      ArenaPrint json(arena);
+      message.update = arena.begin();
+      serializeJson(m_update, json);
+      arena.end();
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef LAZY_MESSAGE
+#define LAZY_MESSAGE
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "DataStructures.h"
+#include "CompactMessage.h"
+
+class AsyncTelegram2;
+
+/*
+    Message that decodes its fields only when they are read: the JSON document of
+    the update is kept until the next poll and each accessor looks up its own field,
+    so a handler that only reads chatId() and text() never copies anything else.
+        if (bot.getNewMessage(msg) == MessageText)
+            Serial.println(msg.text());
+    Strings returned are valid until the next call of getNewMessage().
+    With TELEGRAM_SAX_PARSER the update is already decoded in the queue, so the
+    accessors just read the compact message.
+*/
+class TBLazyMessage
+{
+public:
+  MessageType messageType = MessageNoData;
+
+  int64_t chatId() const;
+  int32_t messageID() const;
+  int32_t date() const;
+  // Text of message (caption for documents)
+  const char *text() const;
+
+  int64_t senderId() const;
+  const char *senderUsername() const;
+  const char *senderFirstName() const;
+  const char *senderLastName() const;
+
+  // MessageQuery
+  int64_t callbackQueryID() const;
+  int32_t chatInstance() const;
+  const char *callbackQueryData() const;
+
+  // MessageLocation
+  TBLocation location() const;
+
+  // MessageContact
+  TBContact contact() const;
+
+  // MessageNewMember, MessageLeftMember
+  TBUser member() const;
+
+  // MessageDocument: file_id, name and size from the update, without file_path
+  // (resolve it with getFile() or downloadFile() when the file is needed)
+  TBDocument document() const;
+
+#if TELEGRAM_SAX_PARSER
+  // MessageUnknown: JSON text of the whole update (empty if the reply was too big
+  // to be parsed in memory, see enableStreamParsing())
+  const char *rawUpdate() const;
+#else
+  // The whole update, as parsed by ArduinoJson (i.e. for MessageUnknown updates)
+  inline JsonVariantConst update() const { return m_update; }
+#endif
+
+  // Decode all the fields in a TBMessage (strings already allocated are reused)
+  void copyTo(TBMessage &message) const;
+
+  // Decode all the fields in a TBCompactMessage (strings are added to arena)
+  void copyTo(TBCompactMessage &message, MessageArena &arena) const;
+
+private:
+  friend class AsyncTelegram2;
+#if TELEGRAM_SAX_PARSER
+  TBCompactMessage m_message = TBCompactMessage();
+
+  void begin(const TBCompactMessage &message);
+#else
+  JsonVariantConst m_update;    // the whole update
+  JsonVariantConst m_message;   // message (or channel post) inside the update
+  JsonVariantConst m_sender;    // user (or channel) who sent the message
+
+  MessageType begin(JsonVariantConst update, bool unknown = false);
+#endif
+};
+
+#endif
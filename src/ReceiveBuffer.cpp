@@ -0,0 +1,117 @@
+#include "ReceiveBuffer.h"
+
+size_t ReceiveBuffer::fill()
+{
+  if (m_client == nullptr)
+    return 0;
+
+  size_t total = 0;
+  while (m_count < RX_BUFFER_SIZE)
+  {
+    int avail = m_client->available();
+    if (avail <= 0)
+      break;
+
+    // Contiguous free space after the last buffered byte
+    size_t tail = (m_head + m_count) % RX_BUFFER_SIZE;
+    size_t space = tail < m_head ? m_head - tail : RX_BUFFER_SIZE - tail;
+    if ((size_t)avail < space)
+      space = avail;
+
+    int len = m_client->read(m_buffer + tail, space);
+    if (len <= 0)
+      break;
+    m_count += len;
+    total += len;
+  }
+  return total;
+}
+
+bool ReceiveBuffer::wait(size_t len, uint32_t timeout)
+{
+  for (uint32_t start = millis(); m_count < len; )
+  {
+    if (fill() == 0)
+    {
+      if (millis() - start > timeout || !m_client->connected())
+        return false;
+      yield();
+    }
+  }
+  return true;
+}
+
+const uint8_t *ReceiveBuffer::data(size_t len)
+{
+  // Requested data is wrapped: rotate the whole buffer so that head is at index 0
+  if (m_head + len > RX_BUFFER_SIZE)
+  {
+    reverse(0, m_head);
+    reverse(m_head, RX_BUFFER_SIZE);
+    reverse(0, RX_BUFFER_SIZE);
+    m_head = 0;
+  }
+  return m_buffer + m_head;
+}
+
+void ReceiveBuffer::consume(size_t len)
+{
+  if (len > m_count)
+    len = m_count;
+  m_count -= len;
+  // Restart from the beginning when empty, so free space is contiguous
+  m_head = m_count ? (m_head + len) % RX_BUFFER_SIZE : 0;
+}
+
+int ReceiveBuffer::read(uint8_t *buffer, size_t len)
+{
+  if (m_count == 0)
+    fill();
+
+  size_t total = 0;
+  while (total < len && m_count)
+  {
+    size_t chunk = RX_BUFFER_SIZE - m_head;
+    if (chunk > m_count)
+      chunk = m_count;
+    if (chunk > len - total)
+      chunk = len - total;
+    memcpy(buffer + total, m_buffer + m_head, chunk);
+    consume(chunk);
+    total += chunk;
+  }
+  return total;
+}
+
+int ReceiveBuffer::available()
+{
+  if (m_count == 0)
+    fill();
+  return m_count;
+}
+
+int ReceiveBuffer::read()
+{
+  if (m_count == 0 && fill() == 0)
+    return -1;
+  uint8_t c = m_buffer[m_head];
+  consume(1);
+  return c;
+}
+
+int ReceiveBuffer::peek()
+{
+  if (m_count == 0 && fill() == 0)
+    return -1;
+  return m_buffer[m_head];
+}
+
+void ReceiveBuffer::reverse(size_t from, size_t to)
+{
+  while (from + 1 < to)
+  {
+    uint8_t tmp = m_buffer[from];
+    m_buffer[from++] = m_buffer[--to];
+    m_buffer[to] = tmp;
+  }
+}
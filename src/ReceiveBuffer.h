@@ -0,0 +1,85 @@
+#ifndef RECEIVE_BUFFER
+#define RECEIVE_BUFFER
+
+#include "Client.h"
+
+/*
+    Size of the receive ring buffer. Bytes are moved from the client with bulk
+    read(buffer, len) calls, so this is also the max size of a single TLS read.
+    A getUpdates reply shorter than this value is parsed in place.
+    The buffer is embedded in each connection, so set a different size as a
+    global build flag (a #define in the sketch doesn't reach the library sources).
+*/
+#ifndef RX_BUFFER_SIZE
+#define RX_BUFFER_SIZE 1024
+#endif
+
+/*
+    Fixed capacity ring buffer fed by the Client with bulk reads.
+    HTTP headers and body are consumed directly from here, without reading
+    the client one byte at time.
+*/
+class ReceiveBuffer : public Stream
+{
+public:
+  inline void setClient(Client *client)
+  {
+    m_client = client;
+  }
+
+  inline size_t capacity() const
+  {
+    return RX_BUFFER_SIZE;
+  }
+
+  // Number of bytes already moved from client to buffer
+  inline size_t size() const
+  {
+    return m_count;
+  }
+
+  // Discard all buffered data (i.e. when connection is closed)
+  inline void clear()
+  {
+    m_head = 0;
+    m_count = 0;
+  }
+
+  // Move as many bytes as possible from client to free space
+  // returns: number of bytes read from client
+  size_t fill();
+
+  // Wait until at least len bytes are buffered (len must be <= capacity())
+  // returns: true if data is available before timeout
+  bool wait(size_t len, uint32_t timeout);
+
+  // Get a pointer to the first len buffered bytes (len must be <= size()).
+  // Data is rearranged in place if it's wrapped around the end of the buffer
+  const uint8_t *data(size_t len);
+
+  // Remove len bytes from the head of buffer
+  void consume(size_t len);
+
+  // Bulk read of buffered data (client is read if buffer is empty)
+  int read(uint8_t *buffer, size_t len);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+
+  // This is a read-only stream
+  size_t write(uint8_t) override
+  {
+    return 0;
+  }
+
+private:
+  Client  *m_client = nullptr;
+  uint8_t m_buffer[RX_BUFFER_SIZE];
+  size_t  m_head = 0;
+  size_t  m_count = 0;
+
+  void reverse(size_t from, size_t to);
+};
+
+#endif
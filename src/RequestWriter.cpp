@@ -0,0 +1,47 @@
+#include "RequestWriter.h"
+
+size_t RequestWriter::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t RequestWriter::write(const uint8_t *buffer, size_t size)
+{
+  if (m_failed)
+    return 0;
+
+  // Data larger than the buffer goes straight to the client
+  if (m_length + size > REQUEST_BUFFER_SIZE)
+  {
+    writeOut(m_buffer, m_length);
+    m_length = 0;
+    if (size >= REQUEST_BUFFER_SIZE)
+    {
+      writeOut(buffer, size);
+      return m_failed ? 0 : size;
+    }
+  }
+  memcpy(m_buffer + m_length, buffer, size);
+  m_length += size;
+  return size;
+}
+
+bool RequestWriter::end()
+{
+  writeOut(m_buffer, m_length);
+  m_length = 0;
+  return !m_failed;
+}
+
+void RequestWriter::writeOut(const uint8_t *data, size_t size)
+{
+  // Client may accept only a part of the data at a time
+  while (size > 0 && !m_failed)
+  {
+    size_t written = m_client.write(data, size);
+    if (written == 0)
+      m_failed = true;
+    data += written;
+    size -= written;
+  }
+}
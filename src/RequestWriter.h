@@ -0,0 +1,43 @@
+#ifndef REQUEST_WRITER
+#define REQUEST_WRITER
+
+#include "Client.h"
+
+// Bytes of a request collected before they are written to the client
+#ifndef REQUEST_BUFFER_SIZE
+#define REQUEST_BUFFER_SIZE 256
+#endif
+
+/*
+    Print that writes to a client through a small buffer: headers and JSON body of
+    a request are printed piece by piece (i.e. serializeJson() writes one token at a
+    time), but reach the client in a few large writes, without a copy of the whole
+    request in memory.
+        RequestWriter writer(client);
+        writer.print(headers);
+        serializeJson(doc, writer);
+        ok = writer.end();
+*/
+class RequestWriter : public Print
+{
+public:
+  explicit RequestWriter(Client &client) : m_client(client) {}
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+
+  // Write the data still in the buffer
+  // returns: false if the client didn't accept all the request
+  bool end();
+
+private:
+  Client  &m_client;
+  uint8_t  m_buffer[REQUEST_BUFFER_SIZE];
+  size_t   m_length = 0;
+  bool     m_failed = false;
+
+  void writeOut(const uint8_t *data, size_t size);
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "SendQueue.h"
+
+bool SendQueue::push(const char *command, const char *payload, uint32_t id)
+{
+  for (uint8_t i = 0; i < SEND_QUEUE_SIZE; i++)
+  {
+    Request &request = m_requests[i];
+    if (request.command != nullptr)
+      continue;
+    request.command = command;
+    request.payload = payload;
+    request.chat = chatOf(payload);
+    request.id = id;
+    request.sent = false;
+    request.seq = m_seq++;
+    m_count++;
+    return true;
+  }
+  return false;
+}
+
+void SendQueue::remove(int8_t index)
+{
+  m_requests[index].command = nullptr;
+  m_requests[index].payload = String();
+  m_count--;
+}
+
+int8_t SendQueue::find(uint32_t id) const
+{
+  for (uint8_t i = 0; i < SEND_QUEUE_SIZE; i++)
+  {
+    if (m_requests[i].command != nullptr && m_requests[i].id == id)
+      return i;
+  }
+  return -1;
+}
+
+void SendQueue::sent(int8_t index, uint32_t now)
+{
+  m_requests[index].sent = true;
+  m_requests[index].sentTime = now;
+}
+
+void SendQueue::done(uint32_t id)
+{
+  int8_t index = find(id);
+  if (index >= 0)
+    remove(index);
+}
+
+bool SendQueue::retry(uint32_t id)
+{
+  int8_t index = find(id);
+  if (index < 0)
+    return false;
+  m_requests[index].sent = false;
+  return true;
+}
+
+void SendQueue::pause(uint32_t now, uint32_t delay)
+{
+  m_pauseTime = now;
+  m_pauseDelay = delay;
+}
+
+uint32_t SendQueue::expired(uint32_t now)
+{
+  for (uint8_t i = 0; i < SEND_QUEUE_SIZE; i++)
+  {
+    if (m_requests[i].command != nullptr && m_requests[i].sent && now - m_requests[i].sentTime > SEND_QUEUE_TIMEOUT)
+    {
+      uint32_t id = m_requests[i].id;
+      remove(i);
+      return id;
+    }
+  }
+  return 0;
+}
+
+int8_t SendQueue::next(uint32_t now)
+{
+  if (m_pauseDelay && now - m_pauseTime < m_pauseDelay)
+    return -1;
+  m_pauseDelay = 0;
+  if (m_count == 0 || tokens(m_global, SEND_RATE_GLOBAL, now) < 1000)
+    return -1;
+
+  int8_t best = -1;
+  uint32_t bestIdle = 0;
+  for (uint8_t i = 0; i < SEND_QUEUE_SIZE; i++)
+  {
+    const Request &request = m_requests[i];
+    if (request.command == nullptr || request.sent)
+      continue;
+
+    // Messages of the same chat are sent in order (after the reply to previous one)
+    bool older = false;
+    for (uint8_t j = 0; j < SEND_QUEUE_SIZE && !older; j++)
+    {
+      older = m_requests[j].command != nullptr && m_requests[j].chat == request.chat &&
+              (int32_t)(m_requests[j].seq - request.seq) < 0;
+    }
+    if (older)
+      continue;
+
+    // Time since the chat was served (chats not tracked are idle since long)
+    uint32_t idle = UINT32_MAX;
+    Bucket *chat = request.chat ? bucket(request.chat, now, false) : nullptr;
+    if (chat != nullptr)
+    {
+      if (tokens(*chat, rateOf(request.chat), now) < 1000)
+        continue;
+      idle = now - chat->served;
+    }
+
+    if (best < 0 || idle > bestIdle || (idle == bestIdle && (int32_t)(request.seq - m_requests[best].seq) < 0))
+    {
+      best = i;
+      bestIdle = idle;
+    }
+  }
+  if (best < 0)
+    return -1;
+
+  int64_t chatId = m_requests[best].chat;
+  if (chatId)
+  {
+    // All the buckets are used by chats still waiting for tokens
+    Bucket *chat = bucket(chatId, now, true);
+    if (chat == nullptr)
+      return -1;
+    take(*chat, rateOf(chatId), now);
+  }
+  take(m_global, SEND_RATE_GLOBAL, now);
+  return best;
+}
+
+// Chat of the request: numeric id, or username of a channel (as negative hash)
+int64_t SendQueue::chatOf(const char *payload)
+{
+  const char *value = strstr(payload, "\"chat_id\":");
+  if (value == nullptr)
+    return 0;
+  value += 10;
+  if (*value != '"')
+    return strtoll(value, nullptr, 10);
+
+  // FNV-1a
+  uint32_t hash = 2166136261UL;
+  for (value++; *value && *value != '"'; value++)
+    hash = (hash ^ (uint8_t)*value) * 16777619UL;
+  return -(int64_t)(hash | 1);
+}
+
+uint32_t SendQueue::rateOf(int64_t chat)
+{
+  // Groups and channels have negative ids
+  return chat < 0 ? SEND_RATE_GROUP : SEND_RATE_CHAT;
+}
+
+// Tokens of a full bucket: messages of one second (at least one)
+uint32_t SendQueue::capacity(uint32_t rate)
+{
+  return rate < 60 ? 1000 : rate * 1000 / 60;
+}
+
+uint32_t SendQueue::tokens(const Bucket &bucket, uint32_t rate, uint32_t now)
+{
+  // After one minute the bucket is full anyway (and no overflow)
+  uint32_t elapsed = now - bucket.served;
+  if (elapsed >= 60000)
+    return capacity(rate);
+  uint32_t level = bucket.level + (uint64_t)elapsed * rate / 60;
+  return level < capacity(rate) ? level : capacity(rate);
+}
+
+void SendQueue::take(Bucket &bucket, uint32_t rate, uint32_t now)
+{
+  bucket.level = tokens(bucket, rate, now) - 1000;
+  bucket.served = now;
+}
+
+// Open addressing hash table. Buckets are never freed: when the table is full, a
+// bucket already refilled is reused (it would be the same of a new one)
+SendQueue::Bucket *SendQueue::bucket(int64_t chat, uint32_t now, bool add)
+{
+  uint32_t hash = (uint32_t)(chat ^ (chat >> 32)) * 2654435761UL;
+  uint8_t start = hash % SEND_QUEUE_CHATS;
+  for (uint8_t n = 0; n < SEND_QUEUE_CHATS; n++)
+  {
+    Bucket &entry = m_buckets[(start + n) % SEND_QUEUE_CHATS];
+    if (entry.chat == chat)
+      return &entry;
+    if (entry.chat == 0)
+    {
+      if (!add)
+        return nullptr;
+      entry.chat = chat;
+      entry.served = now - 60000;
+      entry.level = 0;
+      return &entry;
+    }
+  }
+  if (!add)
+    return nullptr;
+
+  for (uint8_t n = 0; n < SEND_QUEUE_CHATS; n++)
+  {
+    Bucket &entry = m_buckets[n];
+    uint32_t rate = rateOf(entry.chat);
+    if (tokens(entry, rate, now) == capacity(rate))
+    {
+      entry.chat = chat;
+      entry.served = now - 60000;
+      entry.level = 0;
+      return &entry;
+    }
+  }
+  return nullptr;
+}
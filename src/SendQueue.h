@@ -0,0 +1,140 @@
+#ifndef SEND_QUEUE
+#define SEND_QUEUE
+
+#include <Arduino.h>
+
+// Max number of messages waiting to be sent. This and SEND_QUEUE_CHATS size the
+// arrays of SendQueue: change them with global build flags, not in the sketch
+#ifndef SEND_QUEUE_SIZE
+#define SEND_QUEUE_SIZE 8
+#endif
+
+// Number of chats whose sending rate is tracked at the same time
+#ifndef SEND_QUEUE_CHATS
+#define SEND_QUEUE_CHATS 16
+#endif
+
+// Time (ms) a sent message is kept waiting for its reply: then it's dropped and
+// reported as failed (see expired())
+#ifndef SEND_QUEUE_TIMEOUT
+#define SEND_QUEUE_TIMEOUT 30000
+#endif
+
+/*
+    Telegram flood control limits (messages per minute): overall, for each private
+    chat and for each group or channel. Bursts are allowed up to the messages of
+    one second (at least one).
+*/
+#ifndef SEND_RATE_GLOBAL
+#define SEND_RATE_GLOBAL 1800
+#endif
+
+#ifndef SEND_RATE_CHAT
+#define SEND_RATE_CHAT 60
+#endif
+
+#ifndef SEND_RATE_GROUP
+#define SEND_RATE_GROUP 20
+#endif
+
+/*
+    Queue of outgoing messages, sent at the rate allowed by Telegram.
+    A token bucket limits the overall rate and another one, for each chat, the rate
+    of that chat. Chats are served round robin: the next message sent is the oldest
+    one of the chat served least recently, so a busy group can't delay the others.
+    A message stays in the queue until its reply is received, so it can be sent
+    again when Telegram asks to retry later (HTTP 429).
+        SendQueue sendQueue;
+        bot.setSendQueue(&sendQueue);
+*/
+class SendQueue
+{
+public:
+  // Add a request to the queue (payload is copied)
+  // params:
+  //   id: id of the request (not 0), used to find it when its reply is received
+  // returns: false if the queue is full
+  bool push(const char *command, const char *payload, uint32_t id);
+
+  // Number of requests in the queue (also the ones waiting for the reply)
+  inline uint8_t size() const
+  {
+    return m_count;
+  }
+
+  // Find the request to be sent now, and take a token from its buckets
+  // returns: index of the request, -1 if none can be sent yet
+  int8_t next(uint32_t now);
+
+  inline const char *command(int8_t index) const
+  {
+    return m_requests[index].command;
+  }
+
+  inline const char *payload(int8_t index) const
+  {
+    return m_requests[index].payload.c_str();
+  }
+
+  inline uint32_t id(int8_t index) const
+  {
+    return m_requests[index].id;
+  }
+
+  // The request was sent: wait for the reply
+  void sent(int8_t index, uint32_t now);
+
+  // Remove a request once its reply was received
+  void done(uint32_t id);
+
+  // Send again a request (i.e. after a pause)
+  // returns: false if the request is not in the queue
+  bool retry(uint32_t id);
+
+  // Don't send anything for delay ms
+  void pause(uint32_t now, uint32_t delay);
+
+  // Remove a request sent more than SEND_QUEUE_TIMEOUT ms ago and still without reply
+  // returns: its id, 0 if none
+  uint32_t expired(uint32_t now);
+
+private:
+  struct Request
+  {
+    const char *command = nullptr;
+    String      payload;
+    int64_t     chat = 0;
+    uint32_t    id = 0;
+    uint32_t    seq = 0;
+    uint32_t    sentTime = 0;
+    bool        sent = false;
+  };
+
+  // Tokens are counted in thousandths, as they were after last message was sent
+  struct Bucket
+  {
+    int64_t  chat = 0;    // 0 = free
+    uint32_t served = 0;
+    uint32_t level = 0;
+  };
+
+  Request  m_requests[SEND_QUEUE_SIZE];
+  Bucket   m_buckets[SEND_QUEUE_CHATS];
+  Bucket   m_global;
+  uint32_t m_seq = 0;
+  uint32_t m_pauseTime = 0;
+  uint32_t m_pauseDelay = 0;
+  uint8_t  m_count = 0;
+
+  int8_t find(uint32_t id) const;
+  void remove(int8_t index);
+
+  static int64_t chatOf(const char *payload);
+  static uint32_t capacity(uint32_t rate);
+  static uint32_t tokens(const Bucket &bucket, uint32_t rate, uint32_t now);
+  static void take(Bucket &bucket, uint32_t rate, uint32_t now);
+  static uint32_t rateOf(int64_t chat);
+  Bucket *bucket(int64_t chat, uint32_t now, bool add);
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "TLSSessionCache.h"
+
+#if defined(ESP8266)
+#define RTC_SESSION_MAGIC 0x54475353UL
+
+bool BearSSLSession::offer(Client &)
+{
+  // A session never negotiated is all zeros: nothing to resume
+  BearSSL::Session none;
+  m_offered = m_session;
+  return memcmp(&m_offered, &none, sizeof(none)) != 0;
+}
+
+bool BearSSLSession::resumed(Client &)
+{
+  // Server accepted the session offered: its parameters are unchanged
+  return memcmp(&m_offered, &m_session, sizeof(m_session)) == 0;
+}
+
+bool RTCSessionCache::load(uint8_t *data, size_t size)
+{
+  Record record;
+  if (size > RTC_SESSION_SIZE || !ESP.rtcUserMemoryRead(m_offset, (uint32_t *)&record, sizeof(record)))
+    return false;
+  // After power on RTC memory has random content
+  if (record.magic != RTC_SESSION_MAGIC || record.size != size || record.checksum != checksum(record.data, size))
+    return false;
+  memcpy(data, record.data, size);
+  return true;
+}
+
+void RTCSessionCache::save(const uint8_t *data, size_t size)
+{
+  if (size > RTC_SESSION_SIZE)
+    return;
+  Record record;
+  record.magic = RTC_SESSION_MAGIC;
+  record.size = size;
+  memcpy(record.data, data, size);
+  record.checksum = checksum(data, size);
+  ESP.rtcUserMemoryWrite(m_offset, (uint32_t *)&record, sizeof(record));
+}
+
+// FNV-1a
+uint32_t RTCSessionCache::checksum(const uint8_t *data, size_t size)
+{
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < size; i++)
+    hash = (hash ^ data[i]) * 16777619UL;
+  return hash;
+}
+#endif
@@ -0,0 +1,109 @@
+#ifndef TLS_SESSION_CACHE
+#define TLS_SESSION_CACHE
+
+#include <Arduino.h>
+#include <Client.h>
+#if defined(ESP8266)
+#include <WiFiClientSecure.h>
+#endif
+
+/*
+    Storage of the TLS session negotiated with Telegram server.
+    The library keeps the session of the main client in RAM, so a new connection
+    resumes it (abbreviated handshake: no certificate validation and no key exchange)
+    instead of starting a full handshake. A cache keeps the session also across a
+    reset or deep sleep: load() is called before the first connection and save()
+    after each full handshake.
+    Session resumption needs a TLSSession (see below).
+        RTCSessionCache sessionCache;
+        bot.setTLSSessionCache(&sessionCache);
+*/
+class TLSSessionCache
+{
+public:
+  virtual ~TLSSessionCache() {}
+
+  // Copy the stored session in data (left unchanged if there is none)
+  // returns: false if no valid session was stored
+  virtual bool load(uint8_t *data, size_t size) = 0;
+
+  // Store the session negotiated with last full handshake
+  virtual void save(const uint8_t *data, size_t size) = 0;
+};
+
+/*
+    TLS session of the main client, offered to the server with each new connection.
+    On ESP8266 the secure client constructor uses a BearSSLSession; for other clients
+    with a session API derive from this class and pass it to setTLSSession().
+*/
+class TLSSession
+{
+public:
+  virtual ~TLSSession() {}
+
+  // Pass the session kept to client, before it connects
+  // returns: false if there is no session to resume yet
+  virtual bool offer(Client &client) = 0;
+
+  // Called after each connection opened by client
+  // returns: true if the server accepted the session offered (abbreviated handshake)
+  virtual bool resumed(Client &client) = 0;
+
+  // Session negotiated by last full handshake, as loaded and saved by a TLSSessionCache
+  virtual uint8_t *data() = 0;
+  virtual size_t size() const = 0;
+};
+
+#if defined(ESP8266)
+// Session of a BearSSL client: the client updates it with each handshake
+class BearSSLSession : public TLSSession
+{
+public:
+  // Pass it to client.setSession()
+  BearSSL::Session *session() { return &m_session; }
+
+  bool offer(Client &client) override;
+  bool resumed(Client &client) override;
+  uint8_t *data() override { return (uint8_t *)&m_session; }
+  size_t size() const override { return sizeof(m_session); }
+
+private:
+  BearSSL::Session m_session;
+  BearSSL::Session m_offered;
+};
+#endif
+
+#if defined(ESP8266)
+// Max size of a session kept in RTC memory
+#ifndef RTC_SESSION_SIZE
+#define RTC_SESSION_SIZE 128
+#endif
+
+/*
+    Session kept in RTC user memory: it survives deep sleep and reset (not power off).
+    offset: first 4 bytes block of RTC user memory used (RTC_SESSION_SIZE + 12 bytes)
+*/
+class RTCSessionCache : public TLSSessionCache
+{
+public:
+  explicit RTCSessionCache(uint8_t offset = 0) : m_offset(offset) {}
+
+  bool load(uint8_t *data, size_t size) override;
+  void save(const uint8_t *data, size_t size) override;
+
+private:
+  struct Record
+  {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t checksum;
+    uint8_t  data[RTC_SESSION_SIZE];
+  };
+
+  uint8_t m_offset;
+
+  static uint32_t checksum(const uint8_t *data, size_t size);
+};
+#endif
+
+#endif
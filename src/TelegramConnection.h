@@ -0,0 +1,150 @@
+#ifndef TELEGRAM_CONNECTION
+#define TELEGRAM_CONNECTION
+
+#include "ReceiveBuffer.h"
+#include "HttpResponse.h"
+#include "BodyStream.h"
+
+/*
+    Max number of requests sent on the same connection before their replies are
+    read (HTTP pipelining). Replies are matched to requests in the same order.
+    It sizes a member array: override it only with a global build flag.
+*/
+#ifndef MAX_PIPELINED_REQUESTS
+#define MAX_PIPELINED_REQUESTS 4
+#endif
+
+/*
+    A connection to Telegram server: the client with its receive buffer, the parser
+    of the response being received and the requests waiting for a reply.
+    Each class of requests (updates, commands, uploads) can have its own connection.
+*/
+class TelegramConnection
+{
+public:
+  enum RequestKind : uint8_t { RequestPoll, RequestCommand };
+
+  // A request waiting for its reply
+  struct Request
+  {
+    RequestKind kind;
+    uint32_t    id;         // id of the request (0 for polling)
+  };
+
+  Client        *client = nullptr;
+  ReceiveBuffer  rx;
+  HttpResponse   response;
+  BodyStream     body;
+  bool           closeConnection = false;
+  // Body of last reply (the connection of updates uses AsyncTelegram2::m_rxbuffer)
+  String         reply;
+
+  inline void setClient(Client *c)
+  {
+    client = c;
+    rx.setClient(c);
+  }
+
+  // Close the connection: replies to pending requests are lost (see takeLost())
+  inline void stop()
+  {
+    client->stop();
+    lose();
+  }
+
+  // Closed from server before all the replies were received
+  inline void checkClosed()
+  {
+    if (pending() && !client->connected() && !rx.available())
+      stop();
+  }
+
+  // Start again with a new connection
+  inline void clear()
+  {
+    rx.clear();
+    response.begin();
+    lose();
+  }
+
+  // Request (with an id) whose reply was lost when the connection was closed,
+  // in the same order they were sent
+  // returns: its id, 0 if there are no more
+  inline uint32_t takeLost()
+  {
+    if (m_lostCount == 0)
+      return 0;
+    uint32_t id = m_lost[0];
+    m_lostCount--;
+    memmove(m_lost, m_lost + 1, m_lostCount * sizeof(m_lost[0]));
+    return id;
+  }
+
+  // True if the reply to request id is still expected
+  inline bool waiting(uint32_t id) const
+  {
+    for (uint8_t i = 0; i < m_count; i++)
+    {
+      if (m_requests[(m_head + i) % MAX_PIPELINED_REQUESTS].id == id)
+        return true;
+    }
+    return false;
+  }
+
+  // Number of requests waiting for a reply
+  inline uint8_t pending() const
+  {
+    return m_count;
+  }
+
+  inline bool full() const
+  {
+    return m_count == MAX_PIPELINED_REQUESTS;
+  }
+
+  // The request which will be replied first
+  inline const Request &front() const
+  {
+    return m_requests[m_head];
+  }
+
+  // Add a request (the reply will be read after those of previous requests)
+  inline void push(RequestKind kind, uint32_t id = 0)
+  {
+    Request &request = m_requests[(m_head + m_count) % MAX_PIPELINED_REQUESTS];
+    request.kind = kind;
+    request.id = id;
+    m_count++;
+  }
+
+  // Remove the oldest request, once its reply was read
+  inline Request pop()
+  {
+    if (m_count == 0)
+      return Request{RequestCommand, 0};
+    Request request = m_requests[m_head];
+    m_head = (m_head + 1) % MAX_PIPELINED_REQUESTS;
+    m_count--;
+    return request;
+  }
+
+private:
+  Request     m_requests[MAX_PIPELINED_REQUESTS];
+  uint8_t     m_head = 0;
+  uint8_t     m_count = 0;
+  uint32_t    m_lost[MAX_PIPELINED_REQUESTS];
+  uint8_t     m_lostCount = 0;
+
+  // Pending requests are moved to the lost ones (polling requests are not reported)
+  inline void lose()
+  {
+    while (m_count)
+    {
+      Request request = pop();
+      if (request.id && m_lostCount < MAX_PIPELINED_REQUESTS)
+        m_lost[m_lostCount++] = request.id;
+    }
+  }
+};
+
+#endif
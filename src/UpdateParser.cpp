@@ -0,0 +1,646 @@
+#include "UpdateParser.h"
+
+// Hash seed for the keys of the update object (root of path table)
+#define PATH_ROOT 2166136261UL
+
+// Presence of objects which select the type of message
+enum UpdateFlags : uint16_t {
+  HasCallbackQuery = 1 << 0,
+  HasForwardFrom   = 1 << 1,
+  HasChannelPost   = 1 << 2,
+  HasMessage       = 1 << 3,
+  HasLocation      = 1 << 4,
+  HasContact       = 1 << 5,
+  HasNewMember     = 1 << 6,
+  HasLeftMember    = 1 << 7,
+  HasDocument      = 1 << 8,
+  HasReplyTo       = 1 << 9,
+  HasText          = 1 << 10
+};
+
+void UpdateParser::begin(const char *data, size_t len)
+{
+  *this = UpdateParser();
+  m_data = data;
+  m_end = data + len;
+  parseTopLevel();
+}
+
+void UpdateParser::begin(Stream &stream)
+{
+  *this = UpdateParser();
+  m_stream = &stream;
+  parseTopLevel();
+}
+
+int UpdateParser::read()
+{
+  int c = peek();
+  m_peek = -1;
+  return c;
+}
+
+int UpdateParser::peek()
+{
+  if (m_peek < 0) {
+    if (m_stream != nullptr) {
+      // Wait with stream timeout only when no data is ready
+      char c;
+      m_peek = m_stream->read();
+      if (m_peek < 0 && m_stream->readBytes(&c, 1) == 1)
+        m_peek = (uint8_t)c;
+    }
+    else if (m_data < m_end)
+      m_peek = (uint8_t)*m_data++;
+  }
+  return m_peek;
+}
+
+int UpdateParser::skipSpaces()
+{
+  int c = peek();
+  while (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+    m_peek = -1;
+    c = peek();
+  }
+  return c;
+}
+
+bool UpdateParser::expect(char c)
+{
+  if (skipSpaces() != c) {
+    m_error = true;
+    return false;
+  }
+  m_peek = -1;
+  return true;
+}
+
+// Parse top level fields of reply, until "result" value or end of document
+void UpdateParser::parseTopLevel()
+{
+  if (m_resultType == ResultNone) {
+    if (!expect('{'))
+      return;
+    if (skipSpaces() == '}') {
+      read();
+      m_resultType = ResultDone;
+      return;
+    }
+  }
+  else if (skipSpaces() == '}') {
+    read();
+    m_resultType = ResultDone;
+    return;
+  }
+  else if (!expect(','))
+    return;
+
+  while (!m_error) {
+    uint32_t key = PATH_ROOT;
+    char token[24];
+    if (!parseKey(key))
+      return;
+
+    switch (key) {
+      case jsonPathHash("ok"):
+        if (parseToken(token, sizeof(token)))
+          m_ok = strcmp(token, "true") == 0;
+        break;
+      case jsonPathHash("error_code"):
+        if (parseToken(token, sizeof(token)))
+          m_errorCode = atol(token);
+        break;
+      case jsonPathHash("description"):
+        if (expect('"'))
+          parseString(&m_description, nullptr, nullptr, 0);
+        break;
+      case jsonPathHash("parameters"):
+        parseParameters();
+        break;
+      case jsonPathHash("result"):
+        if (skipSpaces() == '[') {
+          read();
+          m_resultType = ResultArray;
+          return;
+        }
+        if (skipSpaces() == '{') {
+          m_resultType = ResultObject;
+          m_isObject = true;
+          return;
+        }
+        skipValue();
+        break;
+      default:
+        skipValue();
+    }
+
+    if (skipSpaces() == '}') {
+      read();
+      m_resultType = ResultDone;
+      return;
+    }
+    expect(',');
+  }
+}
+
+// "parameters" object of an error reply (only "retry_after" is used)
+void UpdateParser::parseParameters()
+{
+  if (skipSpaces() != '{') {
+    skipValue();
+    return;
+  }
+  read();
+  if (skipSpaces() == '}') {
+    read();
+    return;
+  }
+
+  while (!m_error) {
+    uint32_t key = PATH_ROOT;
+    char token[24];
+    if (!parseKey(key))
+      return;
+    if (key != jsonPathHash("retry_after"))
+      skipValue();
+    else if (parseToken(token, sizeof(token)))
+      m_retryAfter = strtoul(token, nullptr, 10);
+
+    if (skipSpaces() != ',')
+      break;
+    read();
+  }
+  expect('}');
+}
+
+bool UpdateParser::next(TBCompactMessage &message, MessageArena &arena)
+{
+  if (m_error)
+    return false;
+
+  if (m_resultType == ResultArray) {
+    int c = skipSpaces();
+    if (c == ',') {
+      read();
+      c = skipSpaces();
+    }
+    if (c == ']') {
+      read();
+      parseTopLevel();
+      return false;
+    }
+  }
+  else if (m_resultType != ResultObject)
+    return false;
+
+  m_flags = 0;
+  m_updateId = 0;
+  m_arena = &arena;
+  message.clear(&arena);
+  // In a memory buffer the update starts at the peeked '{'
+  if (m_stream == nullptr && skipSpaces() == '{')
+    m_updateStart = m_updateEnd = m_data - 1;
+  if (!parseObject(PATH_ROOT, message))
+    return false;
+  if (m_updateStart != nullptr)
+    m_updateEnd = m_data - (m_peek < 0 ? 0 : 1);
+  setMessageType(message);
+
+  // The result object is the last value of interest
+  if (m_resultType == ResultObject)
+    parseTopLevel();
+  return true;
+}
+
+// Hash the key of an object member (the opening quote must be already read)
+bool UpdateParser::parseKey(uint32_t &hash)
+{
+  if (!expect('"'))
+    return false;
+  for (int c = read(); c != '"'; c = read()) {
+    if (c < 0 || c == '\\') {
+      // Keys of Telegram objects don't need escapes
+      m_error = true;
+      return false;
+    }
+    hash = (hash ^ (uint8_t)c) * 16777619UL;
+  }
+  return expect(':');
+}
+
+bool UpdateParser::parseObject(uint32_t path, TBCompactMessage &message)
+{
+  if (!expect('{'))
+    return false;
+  if (++m_depth > UPDATE_PARSER_NESTING) {
+    m_error = true;
+    return false;
+  }
+
+  if (skipSpaces() == '}') {
+    read();
+    m_depth--;
+    return true;
+  }
+
+  // Keys of nested objects are separated from parent path with '/'
+  const uint32_t base = (path == PATH_ROOT) ? path : (path ^ '/') * 16777619UL;
+  while (true) {
+    uint32_t key = base;
+    if (!parseKey(key) || !parseValue(key, message))
+      return false;
+    if (skipSpaces() != ',')
+      break;
+    read();
+  }
+
+  m_depth--;
+  return expect('}');
+}
+
+bool UpdateParser::parseValue(uint32_t path, TBCompactMessage &message)
+{
+  int c = skipSpaces();
+  if (c == '{') {
+    if (enterObject(path))
+      return parseObject(path, message);
+    return skipValue();
+  }
+  if (c == '[')
+    return skipValue();
+
+  char token[24];
+  if (c == '"') {
+    read();
+    uint16_t *field = stringField(path, message);
+    if (!parseString(nullptr, field, token, sizeof(token)))
+      return false;
+  }
+  else if (!parseToken(token, sizeof(token)))
+    return false;
+
+  // Numbers may be also sent as strings (i.e. callback_query id)
+  if (token[0] != '\0')
+    storeValue(path, token, message);
+  return true;
+}
+
+// Read a string value (after the opening quote). Chars are appended to target,
+// or copied in arena (field is set with the offset of new string),
+// or copied into token (up to size - 1 chars), or skipped when all are null
+bool UpdateParser::parseString(String *target, uint16_t *field, char *token, size_t size)
+{
+  char chunk[32];
+  uint8_t len = 0;
+  size_t tokenLen = 0;
+  uint32_t surrogate = 0;
+  if (token != nullptr)
+    token[0] = '\0';
+  if (field != nullptr)
+    *field = m_arena->begin();
+
+  for (int c = read(); c != '"'; c = read()) {
+    if (c < 0) {
+      m_error = true;
+      return false;
+    }
+
+    char utf8[4] = { (char)c };
+    uint8_t n = 1;
+    if (c == '\\') {
+      c = read();
+      switch (c) {
+        case 'b': utf8[0] = '\b'; break;
+        case 'f': utf8[0] = '\f'; break;
+        case 'n': utf8[0] = '\n'; break;
+        case 'r': utf8[0] = '\r'; break;
+        case 't': utf8[0] = '\t'; break;
+        case '"': case '\\': case '/':
+          utf8[0] = c;
+          break;
+        case 'u': {
+          uint32_t code = 0;
+          for (uint8_t i = 0; i < 4; i++) {
+            c = read();
+            if (c >= '0' && c <= '9') code = (code << 4) | (c - '0');
+            else if (c >= 'a' && c <= 'f') code = (code << 4) | (c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') code = (code << 4) | (c - 'A' + 10);
+            else {
+              m_error = true;
+              return false;
+            }
+          }
+          // Emoji are sent as surrogate pairs: join them in a single code point
+          if (code >= 0xD800 && code < 0xDC00) {
+            surrogate = code;
+            continue;
+          }
+          if (code >= 0xDC00 && code < 0xE000 && surrogate) {
+            code = 0x10000 + ((surrogate - 0xD800) << 10) + (code - 0xDC00);
+          }
+          surrogate = 0;
+
+          // Encode code point as UTF-8
+          if (code < 0x80) {
+            utf8[0] = code;
+          }
+          else if (code < 0x800) {
+            utf8[0] = 0xC0 | (code >> 6);
+            utf8[1] = 0x80 | (code & 0x3F);
+            n = 2;
+          }
+          else if (code < 0x10000) {
+            utf8[0] = 0xE0 | (code >> 12);
+            utf8[1] = 0x80 | ((code >> 6) & 0x3F);
+            utf8[2] = 0x80 | (code & 0x3F);
+            n = 3;
+          }
+          else {
+            utf8[0] = 0xF0 | (code >> 18);
+            utf8[1] = 0x80 | ((code >> 12) & 0x3F);
+            utf8[2] = 0x80 | ((code >> 6) & 0x3F);
+            utf8[3] = 0x80 | (code & 0x3F);
+            n = 4;
+          }
+          break;
+        }
+        default:
+          m_error = true;
+          return false;
+      }
+    }
+
+    for (uint8_t i = 0; i < n; i++) {
+      if (target != nullptr || field != nullptr) {
+        // Copy in chunks to limit reallocations
+        chunk[len++] = utf8[i];
+        if (len == sizeof(chunk) - 1) {
+          chunk[len] = '\0';
+          if (field != nullptr)
+            m_arena->append(chunk, len);
+          else
+            *target += chunk;
+          len = 0;
+        }
+      }
+      else if (tokenLen + 1 < size) {
+        token[tokenLen++] = utf8[i];
+        token[tokenLen] = '\0';
+      }
+    }
+  }
+
+  if (target != nullptr && len) {
+    chunk[len] = '\0';
+    *target += chunk;
+  }
+  if (field != nullptr) {
+    m_arena->append(chunk, len);
+    m_arena->end();
+  }
+  return true;
+}
+
+// Read a number or a literal (true, false, null)
+bool UpdateParser::parseToken(char *token, size_t size)
+{
+  size_t len = 0;
+  skipSpaces();
+  for (int c = peek(); c > ' ' && c != ',' && c != '}' && c != ']'; c = peek()) {
+    if (len + 1 < size)
+      token[len++] = c;
+    read();
+  }
+  token[len] = '\0';
+  if (len == 0)
+    m_error = true;
+  return len != 0;
+}
+
+// Skip a value of any type, without recursion
+bool UpdateParser::skipValue()
+{
+  uint8_t depth = 0;
+  do {
+    int c = skipSpaces();
+    if (c == '{' || c == '[') {
+      read();
+      if (++depth > UPDATE_PARSER_NESTING) {
+        m_error = true;
+        return false;
+      }
+    }
+    else if ((c == '}' || c == ']') && depth) {
+      read();
+      depth--;
+    }
+    else if (c == ',' || c == ':') {
+      read();
+    }
+    else if (c == '"') {
+      read();
+      if (!parseString(nullptr, nullptr, nullptr, 0))
+        return false;
+    }
+    else {
+      char token[8];
+      if (!parseToken(token, sizeof(token)))
+        return false;
+    }
+  } while (depth);
+  return true;
+}
+
+/*
+    Path table: each JSON path of the update is listed here with the place
+    where its value is stored. Keys are hashed while they are read,
+    so selecting the destination of a value is just a switch on the path hash.
+*/
+
+// Objects to be parsed (others are skipped). Some of them select the type of message
+bool UpdateParser::enterObject(uint32_t path)
+{
+  switch (path) {
+    case jsonPathHash("callback_query"):
+    case jsonPathHash("callback_query/from"):
+    case jsonPathHash("callback_query/message"):
+    case jsonPathHash("callback_query/message/chat"):
+    case jsonPathHash("channel_post/sender_chat"):
+    case jsonPathHash("channel_post/chat"):
+    case jsonPathHash("message/from"):
+    case jsonPathHash("message/chat"):
+      return true;
+    case jsonPathHash("forward_from"):
+      m_flags |= HasForwardFrom;
+      return true;
+    case jsonPathHash("channel_post"):
+      m_flags |= HasChannelPost;
+      return true;
+    case jsonPathHash("message"):
+      m_flags |= HasMessage;
+      return true;
+    case jsonPathHash("message/location"):
+      m_flags |= HasLocation;
+      return true;
+    case jsonPathHash("message/contact"):
+      m_flags |= HasContact;
+      return true;
+    case jsonPathHash("message/new_chat_member"):
+      m_flags |= HasNewMember;
+      return true;
+    case jsonPathHash("message/left_chat_member"):
+      m_flags |= HasLeftMember;
+      return true;
+    case jsonPathHash("message/document"):
+      m_flags |= HasDocument;
+      return true;
+    case jsonPathHash("message/reply_to_message"):
+      // Only the presence of the replied message is needed
+      m_flags |= HasReplyTo;
+      return false;
+  }
+  return false;
+}
+
+// String values copied to message
+uint16_t *UpdateParser::stringField(uint32_t path, TBCompactMessage &message)
+{
+  switch (path) {
+    case jsonPathHash("callback_query/from/username"):
+    case jsonPathHash("message/from/username"):
+    case jsonPathHash("forward_from/username"):
+    case jsonPathHash("channel_post/sender_chat/title"):
+      return &message.senderUsername;
+    case jsonPathHash("callback_query/from/first_name"):
+    case jsonPathHash("message/from/first_name"):
+    case jsonPathHash("forward_from/first_name"):
+      return &message.senderFirstName;
+    case jsonPathHash("callback_query/from/last_name"):
+    case jsonPathHash("message/from/last_name"):
+    case jsonPathHash("forward_from/last_name"):
+      return &message.senderLastName;
+    case jsonPathHash("callback_query/data"):
+      return &message.query.data;
+    case jsonPathHash("message/text"):
+      m_flags |= HasText;
+      // fall through
+    case jsonPathHash("callback_query/message/text"):
+    case jsonPathHash("channel_post/text"):
+    case jsonPathHash("message/caption"):
+    case jsonPathHash("text"):
+      return &message.text;
+    case jsonPathHash("message/contact/first_name"):
+      return &message.contact.firstName;
+    case jsonPathHash("message/contact/last_name"):
+      return &message.contact.lastName;
+    case jsonPathHash("message/contact/phone_number"):
+      return &message.contact.phoneNumber;
+    case jsonPathHash("message/contact/vcard"):
+      return &message.contact.vCard;
+    case jsonPathHash("message/new_chat_member/first_name"):
+    case jsonPathHash("message/left_chat_member/first_name"):
+      return &message.member.firstName;
+    case jsonPathHash("message/new_chat_member/last_name"):
+    case jsonPathHash("message/left_chat_member/last_name"):
+      return &message.member.lastName;
+    case jsonPathHash("message/new_chat_member/username"):
+    case jsonPathHash("message/left_chat_member/username"):
+      return &message.member.username;
+    case jsonPathHash("message/document/file_id"):
+      return &message.document.fileId;
+    case jsonPathHash("message/document/file_name"):
+      return &message.document.fileName;
+  }
+  return nullptr;
+}
+
+// Numbers and booleans copied to message
+void UpdateParser::storeValue(uint32_t path, const char *token, TBCompactMessage &message)
+{
+  switch (path) {
+    case jsonPathHash("update_id"):
+      m_updateId = strtoul(token, nullptr, 10);
+      break;
+    case jsonPathHash("message_id"):
+      m_messageId = strtoul(token, nullptr, 10);
+      break;
+    case jsonPathHash("callback_query/id"):
+      m_flags |= HasCallbackQuery;
+      message.query.id = atoll(token);
+      break;
+    case jsonPathHash("callback_query/from/id"):
+    case jsonPathHash("message/from/id"):
+    case jsonPathHash("forward_from/id"):
+    case jsonPathHash("channel_post/sender_chat/id"):
+      message.senderId = atoll(token);
+      break;
+    case jsonPathHash("callback_query/message/chat/id"):
+    case jsonPathHash("message/chat/id"):
+    case jsonPathHash("channel_post/chat/id"):
+      message.chatId = atoll(token);
+      break;
+    case jsonPathHash("callback_query/message/message_id"):
+    case jsonPathHash("message/message_id"):
+      message.messageID = atol(token);
+      break;
+    case jsonPathHash("callback_query/message/date"):
+    case jsonPathHash("message/date"):
+      message.date = atol(token);
+      break;
+    case jsonPathHash("callback_query/chat_instance"):
+      message.query.chatInstance = atol(token);
+      break;
+    case jsonPathHash("message/location/longitude"):
+      message.location.longitude = atof(token);
+      break;
+    case jsonPathHash("message/location/latitude"):
+      message.location.latitude = atof(token);
+      break;
+    case jsonPathHash("message/contact/user_id"):
+      message.contact.id = atoll(token);
+      break;
+    case jsonPathHash("message/new_chat_member/is_bot"):
+    case jsonPathHash("message/left_chat_member/is_bot"):
+      message.member.isBot = strcmp(token, "true") == 0;
+      break;
+    case jsonPathHash("message/new_chat_member/id"):
+    case jsonPathHash("message/left_chat_member/id"):
+      message.member.id = atoll(token);
+      break;
+    case jsonPathHash("message/document/file_size"):
+      message.document.fileSize = atol(token);
+      break;
+  }
+}
+
+// Same precedence of the ArduinoJson decoder
+void UpdateParser::setMessageType(TBCompactMessage &message)
+{
+  if (m_flags & HasCallbackQuery)
+    message.messageType = MessageQuery;
+  else if (m_flags & HasForwardFrom)
+    message.messageType = MessageForwarded;
+  else if (m_flags & HasChannelPost)
+    message.messageType = MessageText;
+  else if ((m_flags & HasMessage) && message.messageID) {
+    if (m_flags & HasLocation)
+      message.messageType = MessageLocation;
+    else if (m_flags & HasContact)
+      message.messageType = MessageContact;
+    else if (m_flags & HasNewMember)
+      message.messageType = MessageNewMember;
+    else if (m_flags & HasLeftMember)
+      message.messageType = MessageLeftMember;
+    else if (m_flags & HasDocument) {
+      // File path is requested only when needed (getFile())
+      message.messageType = MessageDocument;
+      message.document.fileExists = message.document.fileId != 0;
+      message.document.filePath = 0;
+    }
+    else if (m_flags & HasReplyTo)
+      message.messageType = MessageReply;
+    else if (m_flags & HasText)
+      message.messageType = MessageText;
+  }
+}
@@ -0,0 +1,111 @@
+#ifndef UPDATE_PARSER
+#define UPDATE_PARSER
+
+#include <Arduino.h>
+#include "CompactMessage.h"
+
+// Max nesting of JSON objects and arrays
+#ifndef UPDATE_PARSER_NESTING
+#define UPDATE_PARSER_NESTING 10
+#endif
+
+// FNV-1a hash of a JSON path relative to the update object (i.e. "message/from/id").
+// It's evaluated at compile time when used in the path table of the parser.
+constexpr uint32_t jsonPathHash(const char *path, uint32_t hash = 2166136261UL)
+{
+  return *path ? jsonPathHash(path + 1, (hash ^ (uint8_t)*path) * 16777619UL) : hash;
+}
+
+/*
+    Single pass, event driven decoder for Telegram replies.
+    Bytes are read only once from a memory buffer or a Stream, and the values
+    whose path is listed in the table of the parser are stored directly
+    in TBCompactMessage (strings in the arena). No JSON document is created
+    and other values are skipped.
+*/
+class UpdateParser
+{
+public:
+  // Start parsing a reply. Top level fields before "result" are parsed here
+  void begin(const char *data, size_t len);
+  void begin(Stream &stream);
+
+  // Decode the next update of "result" array (or the "result" object)
+  // params:
+  //   message: cleared and filled with update fields
+  //   arena: where string fields are copied
+  // returns:
+  //   true if message was filled, false if there are no more updates
+  bool next(TBCompactMessage &message, MessageArena &arena);
+
+  // true if the reply is not a valid JSON document
+  inline bool error() const { return m_error; }
+
+  // Value of "ok" field (available after begin())
+  inline bool ok() const { return m_ok; }
+
+  // Value of "error_code" and "description" fields
+  inline int32_t errorCode() const { return m_errorCode; }
+  inline const String &description() const { return m_description; }
+
+  // Value of "parameters/retry_after" field (0 if missing)
+  inline uint32_t retryAfter() const { return m_retryAfter; }
+
+  // "update_id" of last update decoded with next()
+  inline uint32_t updateId() const { return m_updateId; }
+
+  // JSON text of last update decoded with next(), only when parsing a memory buffer
+  // (nullptr with a Stream). It points in the buffer passed to begin().
+  inline const char *updateData() const { return m_updateStart; }
+  inline size_t updateLength() const { return m_updateEnd - m_updateStart; }
+
+  // "message_id" when "result" is an object (reply to a sent message)
+  inline uint32_t messageId() const { return m_messageId; }
+
+  // true when "result" is an object instead of an array of updates
+  inline bool isObject() const { return m_isObject; }
+
+private:
+  enum ResultType : uint8_t { ResultNone, ResultArray, ResultObject, ResultDone };
+
+  const char *m_data = nullptr;
+  const char *m_end = nullptr;
+  Stream     *m_stream = nullptr;
+  int         m_peek = -1;
+  const char *m_updateStart = nullptr;
+  const char *m_updateEnd = nullptr;
+  MessageArena *m_arena = nullptr;
+
+  bool     m_error = false;
+  bool     m_ok = false;
+  bool     m_isObject = false;
+  uint8_t  m_depth = 0;
+  ResultType m_resultType = ResultNone;
+  int32_t  m_errorCode = 0;
+  String   m_description;
+  uint32_t m_retryAfter = 0;
+  uint32_t m_updateId = 0;
+  uint32_t m_messageId = 0;
+  uint16_t m_flags = 0;
+
+  int  read();
+  int  peek();
+  int  skipSpaces();
+  bool expect(char c);
+
+  void parseTopLevel();
+  void parseParameters();
+  bool parseObject(uint32_t path, TBCompactMessage &message);
+  bool parseValue(uint32_t path, TBCompactMessage &message);
+  bool parseKey(uint32_t &hash);
+  bool parseString(String *target, uint16_t *field, char *token, size_t size);
+  bool parseToken(char *token, size_t size);
+  bool skipValue();
+
+  bool enterObject(uint32_t path);
+  uint16_t *stringField(uint32_t path, TBCompactMessage &message);
+  void storeValue(uint32_t path, const char *token, TBCompactMessage &message);
+  void setMessageType(TBCompactMessage &message);
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "Upload.h"
+#include <new>
+
+Upload::~Upload()
+{
+  end();
+}
+
+bool Upload::begin(const String &head, Stream &stream, size_t size, const char *tail)
+{
+  end();
+  m_stream = &stream;
+  return start(head, size, tail);
+}
+
+bool Upload::begin(const String &head, const uint8_t *data, size_t size, const char *tail)
+{
+  end();
+  m_data = data;
+  return start(head, size, tail);
+}
+
+bool Upload::start(const String &head, size_t size, const char *tail)
+{
+  // Segments are gathered here (stream data can't be read again: what the client
+  // doesn't accept is kept here too)
+  m_block = new (std::nothrow) uint8_t[BLOCK_SIZE];
+  if (m_block == nullptr)
+    return false;
+  m_head = head;
+  m_tail = tail;
+  m_size = size;
+  m_total = head.length() + size + strlen(tail);
+  m_written = 0;
+  m_pos = 0;
+  m_segmentPos = m_segmentLen = 0;
+  m_writes = 0;
+  m_startTime = m_writeTime = millis();
+  m_failed = false;
+  m_state = Head;
+  return true;
+}
+
+void Upload::end()
+{
+  // Upload done (or stopped)
+  if (m_block != nullptr)
+    m_duration = millis() - m_startTime;
+  delete[] m_block;
+  m_block = nullptr;
+  m_stream = nullptr;
+  m_data = nullptr;
+  m_head = String();
+  m_segmentPos = m_segmentLen = 0;
+  m_state = Idle;
+}
+
+void Upload::fail()
+{
+  m_failed = true;
+  end();
+}
+
+bool Upload::run(Client &client)
+{
+  // Free room in socket buffer. A client that has never reported any can't tell
+  // (one block is written), else 0 means the buffer is full: go on with next call
+  int room = client.availableForWrite();
+  if (room > 0)
+    m_roomClient = &client;
+  else if (&client == m_roomClient && client.connected())
+  {
+    // Server doesn't read anymore
+    if (millis() - m_writeTime > UPLOAD_STALL_TIMEOUT)
+    {
+      fail();
+      return false;
+    }
+    return active();
+  }
+  size_t budget = room > 0 ? (size_t)room : BLOCK_SIZE;
+
+  while (active() && budget > 0)
+  {
+    if (m_segmentPos == m_segmentLen && !nextSegment())
+    {
+      // Content-Length was already sent: the request can't be completed
+      fail();
+      return false;
+    }
+
+    size_t len = m_segmentLen - m_segmentPos;
+    if (len > budget)
+      len = budget;
+    size_t sent = client.write(m_segment + m_segmentPos, len);
+    if (sent == 0)
+    {
+      // Socket buffer full: go on with next call
+      if (client.connected())
+        break;
+      fail();
+      return false;
+    }
+    m_writes++;
+    m_writeTime = millis();
+    m_written += sent;
+    m_segmentPos += sent;
+    budget -= sent;
+    if (sent < len)
+      break;
+  }
+  if (!active())
+    end();
+  return active();
+}
+
+// Gather the next segment from the parts of the request
+// returns: false if the stream ended before all data was read
+bool Upload::nextSegment()
+{
+  m_segmentPos = m_segmentLen = 0;
+
+  // A whole block of data from memory is written in place
+  if (m_state == Body && m_stream == nullptr && m_size - m_pos >= BLOCK_SIZE)
+  {
+    m_segment = m_data + m_pos;
+    m_segmentLen = BLOCK_SIZE;
+    advance(BLOCK_SIZE);
+    return true;
+  }
+
+  m_segment = m_block;
+  while (m_state != Idle && m_segmentLen < BLOCK_SIZE)
+  {
+    size_t len = length(m_state) - m_pos;
+    if (len > BLOCK_SIZE - m_segmentLen)
+      len = BLOCK_SIZE - m_segmentLen;
+    uint8_t *dest = m_block + m_segmentLen;
+    if (m_state == Head)
+      memcpy(dest, m_head.c_str() + m_pos, len);
+    else if (m_state == Tail)
+      memcpy(dest, m_tail + m_pos, len);
+    else if (m_stream == nullptr)
+      memcpy(dest, m_data + m_pos, len);
+    else
+    {
+      len = m_stream->readBytes(dest, len);
+      if (len == 0)
+        return false;
+    }
+    m_segmentLen += len;
+    advance(len);
+  }
+  return true;
+}
+
+size_t Upload::length(State part) const
+{
+  if (part == Head)
+    return m_head.length();
+  if (part == Body)
+    return m_size;
+  return strlen(m_tail);
+}
+
+void Upload::advance(size_t len)
+{
+  m_pos += len;
+
+  // Go to next part (skipping the empty ones)
+  while (m_state != Idle && m_pos == length(m_state))
+  {
+    m_pos = 0;
+    m_state = m_state == Head ? Body : m_state == Body ? Tail : Idle;
+  }
+}
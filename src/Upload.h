@@ -0,0 +1,119 @@
+#ifndef UPLOAD
+#define UPLOAD
+
+#include <Arduino.h>
+#include "Client.h"
+
+// Max bytes written to the client at once
+#ifndef BLOCK_SIZE
+#define BLOCK_SIZE 1436 // 2872   // 2 * TCP_MSS
+#endif
+
+// Time (ms) the socket buffer can stay full before the upload fails
+#ifndef UPLOAD_STALL_TIMEOUT
+#define UPLOAD_STALL_TIMEOUT 10000
+#endif
+
+/*
+    Upload of a request with a large body (i.e. a photo), made of a head (HTTP
+    headers and first part of the form), the data read from a Stream or from memory
+    and a tail (end of form).
+    run() writes only what the client can accept now and then returns, so the
+    upload goes on in the background while the main loop runs.
+    The request is written in segments of BLOCK_SIZE bytes gathered from the parts
+    (i.e. head and first data bytes, last data bytes and tail): each client write
+    becomes a TLS record and a TCP segment, so the small parts don't cost one each.
+    Data from memory is written in place, without copy, when a whole block of it
+    is left.
+*/
+class Upload
+{
+public:
+  enum State : uint8_t { Idle, Head, Body, Tail };
+
+  ~Upload();
+
+  // Prepare the upload of size bytes read from stream
+  // returns: false without memory
+  bool begin(const String &head, Stream &stream, size_t size, const char *tail);
+
+  // Prepare the upload of size bytes from data (it must be valid until the end)
+  // returns: false without memory
+  bool begin(const String &head, const uint8_t *data, size_t size, const char *tail);
+
+  // Write the next part of the request
+  // returns: false when the request was written completely (or failed)
+  bool run(Client &client);
+
+  // Stop the upload (what was already written can't be recalled)
+  void end();
+
+  inline bool active() const
+  {
+    return m_state != Idle || m_segmentPos < m_segmentLen;
+  }
+
+  // Client disconnected or stream ended before all data was read
+  inline bool failed() const
+  {
+    return m_failed;
+  }
+
+  // Bytes already written and size of the whole request
+  inline size_t written() const
+  {
+    return m_written;
+  }
+
+  inline size_t total() const
+  {
+    return m_total;
+  }
+
+  // Number of client writes (TLS records) used for the request so far
+  inline uint32_t writes() const
+  {
+    return m_writes;
+  }
+
+  // Time (ms) spent for the request so far (or for the whole request, once done)
+  inline uint32_t duration() const
+  {
+    return active() ? millis() - m_startTime : m_duration;
+  }
+
+private:
+  // Part being gathered into next segment
+  State          m_state = Idle;
+  bool           m_failed = false;
+  String         m_head;
+  const char    *m_tail = "";
+  Stream        *m_stream = nullptr;
+  const uint8_t *m_data = nullptr;
+  size_t         m_size = 0;
+  size_t         m_total = 0;
+  size_t         m_written = 0;
+  // Position in the part being gathered (head, body or tail)
+  size_t         m_pos = 0;
+
+  // Segment being written: m_block, or data from memory written in place
+  uint8_t       *m_block = nullptr;
+  const uint8_t *m_segment = nullptr;
+  size_t         m_segmentPos = 0;
+  size_t         m_segmentLen = 0;
+
+  uint32_t       m_writes = 0;
+  uint32_t       m_startTime = 0;
+  uint32_t       m_duration = 0;
+  uint32_t       m_writeTime = 0;
+  // Last client that reported the free room in its socket buffer
+  Client        *m_roomClient = nullptr;
+
+  bool start(const String &head, size_t size, const char *tail);
+  bool nextSegment();
+  void fail();
+  size_t length(State part) const;
+  void advance(size_t len);
+};
+
+#endif
@@ -0,0 +1,206 @@
+// Minimal host replacement of the Arduino core, just what the library sources need
+#ifndef HOST_TESTS_ARDUINO_H
+#define HOST_TESTS_ARDUINO_H
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+
+#define F(str) str
+#define PROGMEM
+typedef char __FlashStringHelper;
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+uint32_t millis();
+void delay(uint32_t ms);
+inline void yield() {}
+
+class String
+{
+public:
+  String() {}
+  String(const char *str) { if (str) m_str = str; }
+  String(const std::string &str) : m_str(str) {}
+  explicit String(char c) : m_str(1, c) {}
+  String(int value) : m_str(std::to_string(value)) {}
+  String(unsigned value) : m_str(std::to_string(value)) {}
+  String(long value) : m_str(std::to_string(value)) {}
+  String(unsigned long value) : m_str(std::to_string(value)) {}
+  String(long long value) : m_str(std::to_string(value)) {}
+  String(unsigned long long value) : m_str(std::to_string(value)) {}
+  String(double value) : m_str(std::to_string(value)) {}
+
+  bool reserve(size_t size) { m_str.reserve(size); return true; }
+  size_t length() const { return m_str.size(); }
+  const char *c_str() const { return m_str.c_str(); }
+  char *begin() { return &m_str[0]; }
+  void clear() { m_str.clear(); }
+
+  bool concat(const char *str, unsigned int length) { m_str.append(str, length); return true; }
+  bool concat(const char *str) { if (str) m_str += str; return true; }
+  bool concat(const String &str) { m_str += str.m_str; return true; }
+  bool concat(char c) { m_str += c; return true; }
+  template <typename T>
+  String &operator+=(const T &value) { concat(String(value)); return *this; }
+  String &operator+=(const char *str) { concat(str); return *this; }
+  String &operator+=(char c) { concat(c); return *this; }
+
+  int indexOf(char c, unsigned from = 0) const { return position(m_str.find(c, from)); }
+  int indexOf(const char *str, unsigned from = 0) const { return position(m_str.find(str, from)); }
+  int indexOf(const String &str, unsigned from = 0) const { return indexOf(str.c_str(), from); }
+  String substring(unsigned from) const { return from > m_str.size() ? String() : String(m_str.substr(from)); }
+  String substring(unsigned from, unsigned to) const { return from > m_str.size() ? String() : String(m_str.substr(from, to - from)); }
+  long toInt() const { return atol(m_str.c_str()); }
+  char charAt(unsigned index) const { return m_str[index]; }
+  char operator[](unsigned index) const { return m_str[index]; }
+  void remove(unsigned index) { m_str.erase(index); }
+  void remove(unsigned index, unsigned count) { m_str.erase(index, count); }
+  void trim() {}
+  void toLowerCase() { for (char &c : m_str) c = tolower(c); }
+
+  bool equals(const String &str) const { return m_str == str.m_str; }
+  bool equalsIgnoreCase(const String &str) const { return strcasecmp(c_str(), str.c_str()) == 0; }
+  bool startsWith(const String &str) const { return m_str.compare(0, str.length(), str.m_str) == 0; }
+  bool endsWith(const String &str) const
+  {
+    return m_str.size() >= str.length() && m_str.compare(m_str.size() - str.length(), str.length(), str.m_str) == 0;
+  }
+  bool operator==(const String &str) const { return m_str == str.m_str; }
+  bool operator==(const char *str) const { return m_str == (str ? str : ""); }
+  bool operator!=(const String &str) const { return m_str != str.m_str; }
+
+  // Used by ArduinoJson to serialize to a String
+  size_t write(uint8_t c) { m_str += (char)c; return 1; }
+  size_t write(const uint8_t *buffer, size_t size) { m_str.append((const char *)buffer, size); return size; }
+
+private:
+  std::string m_str;
+
+  static int position(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+};
+
+inline String operator+(const String &left, const String &right)
+{
+  String str(left);
+  str.concat(right);
+  return str;
+}
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size)
+  {
+    for (size_t i = 0; i < size; i++)
+      write(buffer[i]);
+    return size;
+  }
+  size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t print(const char *str) { return write(str); }
+  size_t print(const String &str) { return write(str.c_str(), str.length()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  template <typename T>
+  size_t print(const T &value) { return print(String(value)); }
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T &value) { return print(value) + println(); }
+  size_t printf(const char *format, ...)
+  {
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return write(buffer);
+  }
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { m_timeout = timeout; }
+  unsigned long getTimeout() const { return m_timeout; }
+
+  size_t readBytes(char *buffer, size_t length)
+  {
+    size_t count = 0;
+    uint32_t start = millis();
+    while (count < length && millis() - start < m_timeout) {
+      int c = read();
+      if (c >= 0)
+        buffer[count++] = c;
+    }
+    return count;
+  }
+  size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+
+  String readStringUntil(char terminator)
+  {
+    String str;
+    uint32_t start = millis();
+    while (millis() - start < m_timeout) {
+      int c = read();
+      if (c == terminator)
+        break;
+      if (c >= 0)
+        str += (char)c;
+    }
+    return str;
+  }
+
+  bool find(const char *target)
+  {
+    size_t index = 0, length = strlen(target);
+    uint32_t start = millis();
+    while (millis() - start < m_timeout) {
+      int c = read();
+      if (c < 0)
+        continue;
+      if (c == target[index]) {
+        if (++index == length)
+          return true;
+      }
+      else
+        index = c == target[0] ? 1 : 0;
+    }
+    return false;
+  }
+
+protected:
+  unsigned long m_timeout = 1000;
+};
+
+// Debug output goes to stderr
+class HostSerial : public Stream
+{
+public:
+  size_t write(uint8_t c) override { return fputc(c, stderr) == EOF ? 0 : 1; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+};
+extern HostSerial Serial;
+
+class IPAddress
+{
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*
+    Client talking to a scripted Telegram server in memory: each request written is
+    answered at once by the handler, with the reply for the method called.
+    Requests are recorded with the time they were sent.
+*/
+#ifndef HOST_TESTS_SCRIPTED_CLIENT_H
+#define HOST_TESTS_SCRIPTED_CLIENT_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Client.h"
+
+class ScriptedClient : public Client
+{
+public:
+  struct Request
+  {
+    std::string method;
+    std::string body;
+    uint32_t    time;
+  };
+
+  // Reply to method called with body (an empty string leaves the request without reply)
+  std::function<std::string(const std::string &method, const std::string &body)> handler;
+  std::vector<Request> requests;
+
+  // HTTP response with a JSON body
+  static std::string reply(const std::string &body, const char *status = "200 OK")
+  {
+    return std::string("HTTP/1.1 ") + status + "\r\nContent-Type: application/json\r\nContent-Length: " +
+           std::to_string(body.size()) + "\r\n\r\n" + body;
+  }
+
+  // Number of requests to method sent so far
+  size_t count(const char *method) const
+  {
+    size_t n = 0;
+    for (const Request &request : requests)
+      n += request.method == method;
+    return n;
+  }
+
+  int connect(IPAddress, uint16_t) override { return m_connected = true; }
+  int connect(const char *, uint16_t) override { return m_connected = true; }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override
+  {
+    m_tx.append((const char *)buffer, size);
+    serve();
+    return size;
+  }
+  int available() override { return m_connected ? (int)(m_rx.size() - m_rxPos) : 0; }
+  int read() override { return m_rxPos < m_rx.size() ? (uint8_t)m_rx[m_rxPos++] : -1; }
+  int read(uint8_t *buffer, size_t size) override
+  {
+    size_t n = m_rx.size() - m_rxPos < size ? m_rx.size() - m_rxPos : size;
+    if (n == 0)
+      return -1;
+    memcpy(buffer, m_rx.data() + m_rxPos, n);
+    m_rxPos += n;
+    return (int)n;
+  }
+  int peek() override { return m_rxPos < m_rx.size() ? (uint8_t)m_rx[m_rxPos] : -1; }
+  void flush() override {}
+  void stop() override
+  {
+    m_connected = false;
+    m_tx.clear();
+    m_rx.clear();
+    m_rxPos = 0;
+  }
+  uint8_t connected() override { return m_connected; }
+  operator bool() override { return m_connected; }
+
+private:
+  bool        m_connected = false;
+  std::string m_tx;
+  std::string m_rx;
+  size_t      m_rxPos = 0;
+
+  // Answer the complete requests written so far
+  void serve()
+  {
+    while (true) {
+      size_t end = m_tx.find("\r\n\r\n");
+      if (end == std::string::npos)
+        return;
+      size_t length = 0, header = m_tx.find("Content-Length: ");
+      if (header != std::string::npos && header < end)
+        length = atoi(m_tx.c_str() + header + 16);
+      if (m_tx.size() < end + 4 + length)
+        return;
+
+      // POST /bot<token>/<method> HTTP/1.1
+      size_t slash = m_tx.find('/', m_tx.find("/bot") + 1);
+      Request request;
+      request.method = m_tx.substr(slash + 1, m_tx.find(' ', slash) - slash - 1);
+      request.body = m_tx.substr(end + 4, length);
+      request.time = millis();
+      m_tx.erase(0, end + 4 + length);
+      requests.push_back(request);
+      if (handler)
+        m_rx += handler(request.method, request.body);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,81 @@
+/*
+    downloadFile() waits before each retry when the server can't be reached, with the
+    delay of failed polls: the update time, doubled on each retry.
+*/
+#include <stdio.h>
+
+#include "AsyncTelegram2.h"
+#include "ScriptedClient.h"
+
+static int failures = 0;
+#define CHECK(condition)                                                  \
+  do {                                                                    \
+    if (!(condition)) {                                                   \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      failures++;                                                         \
+    }                                                                     \
+  } while (0)
+
+// Client that can't connect anymore once offline
+class OfflineClient : public ScriptedClient
+{
+public:
+  bool                  offline = false;
+  std::vector<uint32_t> attempts;
+
+  int connect(IPAddress ip, uint16_t port) override { return offline ? refuse() : ScriptedClient::connect(ip, port); }
+  int connect(const char *host, uint16_t port) override { return offline ? refuse() : ScriptedClient::connect(host, port); }
+
+private:
+  int refuse()
+  {
+    attempts.push_back(millis());
+    return 0;
+  }
+};
+
+class NullPrint : public Print
+{
+public:
+  size_t write(uint8_t) override { return 1; }
+};
+
+int main()
+{
+  OfflineClient client;
+  client.handler = [](const std::string &method, const std::string &) -> std::string {
+    if (method == "getMe")
+      return ScriptedClient::reply("{\"ok\":true,\"result\":{\"id\":1,\"is_bot\":true,\"username\":\"TestBot\"}}");
+    return ScriptedClient::reply("{\"ok\":true,\"result\":[]}");
+  };
+
+  AsyncTelegram2 bot(client);
+  bot.setTelegramToken("TOKEN");
+  bot.setUpdateTime(MIN_UPDATE_TIME);
+  CHECK(bot.begin());
+
+  client.stop();
+  client.offline = true;
+  TBDocument document;
+  document.file_path = "https://api.telegram.org/file/botTOKEN/documents/file_1.pdf";
+  document.file_size = 100;
+  NullPrint sink;
+  CHECK(!bot.downloadFile(document, sink));
+
+  // First attempt at once, then DOWNLOAD_RETRIES retries with a growing delay
+  CHECK(client.attempts.size() >= DOWNLOAD_RETRIES + 1);
+  uint32_t expected = MIN_UPDATE_TIME, previous = 0;
+  for (size_t i = 1; i < client.attempts.size(); i++) {
+    // Several connect() calls of the same attempt (i.e. recovery) are close together
+    uint32_t gap = client.attempts[i] - client.attempts[i - 1];
+    if (gap < MIN_UPDATE_TIME / 2)
+      continue;
+    CHECK(gap >= expected && gap > previous);
+    previous = gap;
+    expected *= 2;
+  }
+  CHECK(expected == MIN_UPDATE_TIME << DOWNLOAD_RETRIES);
+
+  printf("download_retry: %s\n", failures ? "FAILED" : "OK");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,63 @@
+/*
+    A 429 Too Many Requests reply to sendMessage pauses sending for retry_after
+    seconds, while getUpdates polling goes on at the normal rate.
+*/
+#include <stdio.h>
+
+#include "AsyncTelegram2.h"
+#include "ScriptedClient.h"
+
+static int failures = 0;
+#define CHECK(condition)                                                  \
+  do {                                                                    \
+    if (!(condition)) {                                                   \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      failures++;                                                         \
+    }                                                                     \
+  } while (0)
+
+int main()
+{
+  ScriptedClient client;
+  client.handler = [](const std::string &method, const std::string &) -> std::string {
+    if (method == "getMe")
+      return ScriptedClient::reply("{\"ok\":true,\"result\":{\"id\":1,\"is_bot\":true,\"username\":\"TestBot\"}}");
+    if (method == "sendMessage")
+      return ScriptedClient::reply("{\"ok\":false,\"error_code\":429,\"description\":\"Too Many Requests: retry after 30\","
+                                   "\"parameters\":{\"retry_after\":30}}",
+                                   "429 Too Many Requests");
+    return ScriptedClient::reply("{\"ok\":true,\"result\":[]}");
+  };
+
+  AsyncTelegram2 bot(client);
+  bot.setTelegramToken("TOKEN");
+  bot.setUpdateTime(MIN_UPDATE_TIME);
+  CHECK(bot.begin());
+
+  TBMessage msg;
+  // Without a SendQueue, messages are sent at once (sendTo() returns false since it doesn't wait the reply)
+  bot.sendTo(42, "throttled");
+  CHECK(client.count("sendMessage") == 1);
+  uint32_t start = millis();
+  while (bot.getLastResult().httpStatus != 429 && millis() - start < 1000) {
+    bot.getNewMessage(msg);
+    delay(1);
+  }
+  CHECK(bot.getLastResult().httpStatus == 429 && bot.getLastResult().retryAfter == 30);
+
+  // Sending is paused...
+  bot.sendTo(42, "refused");
+  CHECK(client.count("sendMessage") == 1);
+
+  // ...but updates are still received
+  size_t polls = client.count("getUpdates");
+  start = millis();
+  while (millis() - start < 4 * MIN_UPDATE_TIME) {
+    bot.getNewMessage(msg);
+    delay(1);
+  }
+  CHECK(client.count("getUpdates") >= polls + 3);
+
+  printf("flood_poll: %s\n", failures ? "FAILED" : "OK");
+  return failures ? 1 : 0;
+}
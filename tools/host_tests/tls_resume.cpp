@@ -0,0 +1,240 @@
+/*
+    With a TLSSession, the second connection of the main client resumes the session
+    negotiated by the first one. The server is a local OpenSSL one (set with
+    setTelegramServer()), the client an OpenSSL Client with a session API.
+*/
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include "AsyncTelegram2.h"
+
+static int failures = 0;
+#define CHECK(condition)                                                  \
+  do {                                                                    \
+    if (!(condition)) {                                                   \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      failures++;                                                         \
+    }                                                                     \
+  } while (0)
+
+// TLS server on 127.0.0.1, with a self signed certificate and the default session cache
+class TestServer
+{
+public:
+  TestServer()
+  {
+    m_ctx = SSL_CTX_new(TLS_server_method());
+    // TLS 1.2: the session is available as soon as the handshake is done
+    SSL_CTX_set_max_proto_version(m_ctx, TLS1_2_VERSION);
+    SSL_CTX_set_session_id_context(m_ctx, (const unsigned char *)"tls_resume", 10);
+
+    EVP_PKEY *key = EVP_EC_gen("P-256");
+    X509 *cert = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC, (const unsigned char *)"localhost", -1, -1, 0);
+    X509_set_issuer_name(cert, X509_get_subject_name(cert));
+    X509_sign(cert, key, EVP_sha256());
+    SSL_CTX_use_certificate(m_ctx, cert);
+    SSL_CTX_use_PrivateKey(m_ctx, key);
+    X509_free(cert);
+    EVP_PKEY_free(key);
+
+    m_socket = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(address);
+    bind(m_socket, (sockaddr *)&address, size);
+    getsockname(m_socket, (sockaddr *)&address, &size);
+    port = ntohs(address.sin_port);
+    listen(m_socket, 4);
+    m_thread = std::thread(&TestServer::run, this);
+  }
+
+  ~TestServer()
+  {
+    m_running = false;
+    shutdown(m_socket, SHUT_RDWR);
+    close(m_socket);
+    m_thread.join();
+    SSL_CTX_free(m_ctx);
+  }
+
+  uint16_t port = 0;
+
+private:
+  SSL_CTX          *m_ctx;
+  int               m_socket;
+  std::atomic<bool> m_running{true};
+  std::thread       m_thread;
+
+  // One connection at a time: handshake, then wait for the client to close it
+  void run()
+  {
+    while (m_running) {
+      int fd = accept(m_socket, nullptr, nullptr);
+      if (fd < 0)
+        return;
+      SSL *ssl = SSL_new(m_ctx);
+      SSL_set_fd(ssl, fd);
+      if (SSL_accept(ssl) == 1) {
+        char buffer[256];
+        while (SSL_read(ssl, buffer, sizeof(buffer)) > 0)
+          ;
+        SSL_shutdown(ssl);
+      }
+      SSL_free(ssl);
+      close(fd);
+    }
+  }
+};
+
+// Client of TestServer (the certificate is not verified)
+class OpenSSLClient : public Client
+{
+public:
+  OpenSSLClient() { m_ctx = SSL_CTX_new(TLS_client_method()); }
+  ~OpenSSLClient()
+  {
+    stop();
+    SSL_CTX_free(m_ctx);
+  }
+
+  // Session offered with next connection
+  SSL_SESSION *session = nullptr;
+
+  SSL *ssl() { return m_ssl; }
+
+  int connect(IPAddress, uint16_t) override { return 0; }
+  int connect(const char *host, uint16_t port) override
+  {
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &address.sin_addr) != 1)
+      return 0;
+    m_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (::connect(m_socket, (sockaddr *)&address, sizeof(address)) != 0) {
+      stop();
+      return 0;
+    }
+    m_ssl = SSL_new(m_ctx);
+    SSL_set_fd(m_ssl, m_socket);
+    if (session != nullptr)
+      SSL_set_session(m_ssl, session);
+    if (SSL_connect(m_ssl) != 1) {
+      stop();
+      return 0;
+    }
+    return 1;
+  }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override
+  {
+    return m_ssl != nullptr && SSL_write(m_ssl, buffer, (int)size) > 0 ? size : 0;
+  }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int read(uint8_t *, size_t) override { return -1; }
+  int peek() override { return -1; }
+  void flush() override {}
+  void stop() override
+  {
+    if (m_ssl != nullptr) {
+      SSL_shutdown(m_ssl);
+      SSL_free(m_ssl);
+      m_ssl = nullptr;
+    }
+    if (m_socket >= 0) {
+      close(m_socket);
+      m_socket = -1;
+    }
+  }
+  uint8_t connected() override { return m_ssl != nullptr; }
+  operator bool() override { return m_ssl != nullptr; }
+
+private:
+  SSL_CTX *m_ctx;
+  SSL     *m_ssl = nullptr;
+  int      m_socket = -1;
+};
+
+// Session of OpenSSLClient, kept in DER format (the format a TLSSessionCache would store)
+class OpenSSLSession : public TLSSession
+{
+public:
+  ~OpenSSLSession() { SSL_SESSION_free(m_offered); }
+
+  bool offer(Client &client) override
+  {
+    SSL_SESSION_free(m_offered);
+    const unsigned char *der = m_der;
+    m_offered = m_length ? d2i_SSL_SESSION(nullptr, &der, m_length) : nullptr;
+    static_cast<OpenSSLClient &>(client).session = m_offered;
+    return m_offered != nullptr;
+  }
+
+  bool resumed(Client &client) override
+  {
+    SSL *ssl = static_cast<OpenSSLClient &>(client).ssl();
+    if (SSL_session_reused(ssl))
+      return true;
+    // Full handshake: keep the new session
+    unsigned char *der = m_der;
+    SSL_SESSION *session = SSL_get_session(ssl);
+    m_length = i2d_SSL_SESSION(session, nullptr) <= (int)sizeof(m_der) ? i2d_SSL_SESSION(session, &der) : 0;
+    return false;
+  }
+
+  uint8_t *data() override { return m_der; }
+  size_t size() const override { return sizeof(m_der); }
+
+private:
+  unsigned char m_der[2048];
+  int           m_length = 0;
+  SSL_SESSION  *m_offered = nullptr;
+};
+
+int main()
+{
+  TestServer server;
+  OpenSSLClient client;
+  OpenSSLSession session;
+
+  AsyncTelegram2 bot(client);
+  bot.setTelegramToken("TOKEN");
+  bot.setTelegramServer("127.0.0.1", server.port);
+  bot.setTLSSession(&session);
+
+  CHECK(bot.checkConnection());
+  CHECK(bot.getHandshakeStats().handshakes == 1 && bot.getHandshakeStats().resumed == 0);
+
+  // Reconnection: the session of the first handshake is offered and resumed
+  client.stop();
+  CHECK(bot.checkConnection());
+  CHECK(bot.getHandshakeStats().handshakes == 2 && bot.getHandshakeStats().resumed == 1);
+
+  // Without a TLSSession every connection is a full handshake
+  client.stop();
+  bot.setTLSSession(nullptr);
+  client.session = nullptr;
+  CHECK(bot.checkConnection());
+  CHECK(bot.getHandshakeStats().handshakes == 3 && bot.getHandshakeStats().resumed == 1);
+  client.stop();
+
+  printf("tls_resume: %s\n", failures ? "FAILED" : "OK");
+  return failures ? 1 : 0;
+}
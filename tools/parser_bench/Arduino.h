@@ -0,0 +1,66 @@
+// Minimal host replacement of the Arduino core, just what UpdateParser and TBLazyMessage need
+#ifndef PARSER_BENCH_ARDUINO_H
+#define PARSER_BENCH_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+inline unsigned long millis()
+{
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+class String : public std::string
+{
+public:
+  using std::string::string;
+  String() {}
+  String(const std::string &str) : std::string(str) {}
+  String &operator+=(const char *str) { append(str); return *this; }
+  String &operator=(const char *str) { assign(str ? str : ""); return *this; }
+};
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size)
+  {
+    for (size_t i = 0; i < size; i++)
+      write(buffer[i]);
+    return size;
+  }
+};
+
+class Stream
+{
+public:
+  virtual ~Stream() {}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { m_timeout = timeout; }
+
+  size_t readBytes(char *buffer, size_t length)
+  {
+    size_t count = 0;
+    unsigned long start = millis();
+    while (count < length && millis() - start < m_timeout) {
+      int c = read();
+      if (c >= 0)
+        buffer[count++] = c;
+    }
+    return count;
+  }
+
+private:
+  unsigned long m_timeout = 1000;
+};
+
+#endif
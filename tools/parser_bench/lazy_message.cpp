@@ -0,0 +1,6 @@
+// TBLazyMessage sources, without the rest of the library: LazyMessage.cpp includes
+// AsyncTelegram2.h, which needs the whole Arduino core
+#define ASYNCTELEGRAMV2
+#define ARDUINOJSON_ENABLE_ARDUINO_PRINT 1
+#include "LazyMessage.h"
+#include "../../src/LazyMessage.cpp"
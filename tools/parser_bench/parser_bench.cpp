@@ -0,0 +1,320 @@
+/*
+    Host benchmark: decode getUpdates replies with ArduinoJson (filtered JsonDocument
+    read through TBLazyMessage, like AsyncTelegram2 does without TELEGRAM_SAX_PARSER)
+    and with the single pass UpdateParser.
+    Prints time per reply, peak heap used while decoding and heap allocations per reply.
+*/
+#include <new>
+#include <stdio.h>
+#include <vector>
+
+#include "Arduino.h"
+// TBLazyMessage serializes unknown updates to a Print
+#define ARDUINOJSON_ENABLE_ARDUINO_PRINT 1
+#include <ArduinoJson.h>
+#include "UpdateParser.h"
+#include "LazyMessage.h"
+
+#if ARDUINOJSON_VERSION_MAJOR < 7
+#error "parser_bench needs ArduinoJson 7 (custom allocator)"
+#endif
+
+/*
+    Heap accounting: every allocation (operator new, JsonDocument pools) goes through
+    tracked functions which store the block size before the returned pointer.
+*/
+static size_t heapUsed = 0;
+static size_t heapPeak = 0;
+static size_t heapAllocations = 0;
+static const size_t headerSize = 16;
+
+static void *trackedAlloc(size_t size)
+{
+  char *block = (char *)malloc(size + headerSize);
+  if (block == nullptr)
+    return nullptr;
+  *(size_t *)block = size;
+  heapAllocations++;
+  heapUsed += size;
+  if (heapUsed > heapPeak)
+    heapPeak = heapUsed;
+  return block + headerSize;
+}
+
+static void trackedFree(void *ptr)
+{
+  if (ptr == nullptr)
+    return;
+  char *block = (char *)ptr - headerSize;
+  heapUsed -= *(size_t *)block;
+  free(block);
+}
+
+static void *trackedRealloc(void *ptr, size_t size)
+{
+  if (ptr == nullptr)
+    return trackedAlloc(size);
+  char *block = (char *)ptr - headerSize;
+  size_t oldSize = *(size_t *)block;
+  block = (char *)realloc(block, size + headerSize);
+  if (block == nullptr)
+    return nullptr;
+  *(size_t *)block = size;
+  heapUsed = heapUsed - oldSize + size;
+  if (heapUsed > heapPeak)
+    heapPeak = heapUsed;
+  return block + headerSize;
+}
+
+void *operator new(size_t size)
+{
+  void *ptr = trackedAlloc(size);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept { trackedFree(ptr); }
+void operator delete(void *ptr, size_t) noexcept { trackedFree(ptr); }
+
+class TrackedAllocator : public ArduinoJson::Allocator
+{
+public:
+  void *allocate(size_t size) override { return trackedAlloc(size); }
+  void deallocate(void *ptr) override { trackedFree(ptr); }
+  void *reallocate(void *ptr, size_t size) override { return trackedRealloc(ptr, size); }
+};
+
+static TrackedAllocator allocator;
+
+// Same fields listed in updateFilterFields (AsyncTelegram2.cpp)
+static const char *const filterFields[] = {
+  "update_id",
+  "callback_query/id", "callback_query/from/id", "callback_query/from/username",
+  "callback_query/from/first_name", "callback_query/from/last_name",
+  "callback_query/message/chat/id", "callback_query/message/message_id",
+  "callback_query/message/date", "callback_query/message/text",
+  "callback_query/chat_instance", "callback_query/data",
+  "channel_post/sender_chat/id", "channel_post/sender_chat/title",
+  "channel_post/chat/id", "channel_post/text",
+  "message/message_id", "message/from/id", "message/from/username",
+  "message/from/first_name", "message/from/last_name", "message/chat/id",
+  "message/date", "message/text", "message/caption",
+  "message/location/longitude", "message/location/latitude",
+  "message/contact/user_id", "message/contact/first_name", "message/contact/last_name",
+  "message/contact/phone_number", "message/contact/vcard",
+  "message/new_chat_member/is_bot", "message/new_chat_member/id",
+  "message/new_chat_member/first_name", "message/new_chat_member/last_name",
+  "message/new_chat_member/username",
+  "message/left_chat_member/is_bot", "message/left_chat_member/id",
+  "message/left_chat_member/first_name", "message/left_chat_member/last_name",
+  "message/left_chat_member/username",
+  "message/document/file_id", "message/document/file_name", "message/document/file_size",
+  "message/reply_to_message/message_id"
+};
+
+static JsonDocument filter;
+
+static void initFilter()
+{
+  filter["ok"] = true;
+  filter["error_code"] = true;
+  filter["description"] = true;
+  filter["parameters"] = true;
+  JsonObject update = filter["result"].add<JsonObject>();
+  for (const char *path : filterFields) {
+    JsonObject node = update;
+    std::string key;
+    for (const char *p = path; ; p++) {
+      if (*p == '/' || *p == '\0') {
+        if (*p == '\0') {
+          node[key.c_str()] = true;
+          break;
+        }
+        JsonVariant child = node[key.c_str()];
+        node = child.is<JsonObject>() ? child.as<JsonObject>() : child.to<JsonObject>();
+        key.clear();
+      }
+      else
+        key += *p;
+    }
+  }
+}
+
+// TBLazyMessage::begin() is private: in the library it's called by AsyncTelegram2
+class AsyncTelegram2
+{
+public:
+  static MessageType queue(TBLazyMessage &slot, JsonVariantConst update)
+  {
+    return slot.begin(update);
+  }
+};
+
+static size_t decodeWithArduinoJson(const std::string &json, TBCompactMessage *queue, size_t size, MessageArena &arena)
+{
+  arena.clear();
+  JsonDocument doc(&allocator);
+  if (deserializeJson(doc, json.c_str(), json.size(), DeserializationOption::Filter(filter)))
+    return 0;
+  // Updates are queued as TBLazyMessage and copied when read with getNewMessage()
+  TBLazyMessage slot;
+  size_t count = 0;
+  for (JsonVariantConst result : doc["result"].as<JsonArrayConst>()) {
+    if (count == size)
+      break;
+    if (AsyncTelegram2::queue(slot, result) != MessageNoData)
+      slot.copyTo(queue[count++], arena);
+  }
+  return count;
+}
+
+// Single pass decoding, from memory or reading a Stream byte by byte
+class MemoryStream : public Stream
+{
+public:
+  MemoryStream(const std::string &data) : m_data(data) {}
+  int available() override { return m_data.size() - m_pos; }
+  int read() override { return m_pos < m_data.size() ? (uint8_t)m_data[m_pos++] : -1; }
+  int peek() override { return m_pos < m_data.size() ? (uint8_t)m_data[m_pos] : -1; }
+private:
+  const std::string &m_data;
+  size_t m_pos = 0;
+};
+
+static size_t decodeUpdates(UpdateParser &parser, TBCompactMessage *queue, size_t size, MessageArena &arena)
+{
+  size_t count = 0;
+  while (count < size) {
+    if (!parser.next(queue[count], arena))
+      break;
+    if (queue[count].messageType != MessageNoData)
+      count++;
+  }
+  return parser.error() ? 0 : count;
+}
+
+static size_t decodeWithParser(const std::string &json, TBCompactMessage *queue, size_t size, MessageArena &arena)
+{
+  arena.clear();
+  UpdateParser parser;
+  parser.begin(json.c_str(), json.size());
+  return decodeUpdates(parser, queue, size, arena);
+}
+
+static size_t decodeWithParserStream(const std::string &json, TBCompactMessage *queue, size_t size, MessageArena &arena)
+{
+  arena.clear();
+  MemoryStream stream(json);
+  UpdateParser parser;
+  parser.begin(stream);
+  return decodeUpdates(parser, queue, size, arena);
+}
+
+// Sample replies
+static std::string textUpdate(uint32_t id, const std::string &text)
+{
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%u", id);
+  return std::string("{\"update_id\":") + buf + ",\"message\":{\"message_id\":" + buf +
+         ",\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"Mario\",\"last_name\":\"Rossi\","
+         "\"username\":\"mrossi\",\"language_code\":\"it\"},\"chat\":{\"id\":123456789,\"first_name\":\"Mario\","
+         "\"last_name\":\"Rossi\",\"username\":\"mrossi\",\"type\":\"private\"},\"date\":1700000000,"
+         "\"text\":\"" + text + "\",\"entities\":[{\"offset\":0,\"length\":6,\"type\":\"bot_command\"}]}}";
+}
+
+static const char *callbackUpdate =
+  "{\"update_id\":901,\"callback_query\":{\"id\":\"530210391857294617\",\"from\":{\"id\":123456789,"
+  "\"is_bot\":false,\"first_name\":\"Mario\",\"username\":\"mrossi\",\"language_code\":\"it\"},"
+  "\"message\":{\"message_id\":77,\"from\":{\"id\":555,\"is_bot\":true,\"first_name\":\"Bot\","
+  "\"username\":\"test_bot\"},\"chat\":{\"id\":123456789,\"first_name\":\"Mario\",\"type\":\"private\"},"
+  "\"date\":1700000100,\"text\":\"Choose an option\",\"reply_markup\":{\"inline_keyboard\":"
+  "[[{\"text\":\"ON\",\"callback_data\":\"LIGHT_ON\"},{\"text\":\"OFF\",\"callback_data\":\"LIGHT_OFF\"}],"
+  "[{\"text\":\"Website\",\"url\":\"https://github.com/cotestatnt/AsyncTelegram2\"}]]}},"
+  "\"chat_instance\":\"-4857129475629384756\",\"data\":\"LIGHT_ON\"}}";
+
+static const char *locationUpdate =
+  "{\"update_id\":902,\"message\":{\"message_id\":78,\"from\":{\"id\":123456789,\"is_bot\":false,"
+  "\"first_name\":\"Mario\"},\"chat\":{\"id\":123456789,\"type\":\"private\"},\"date\":1700000200,"
+  "\"location\":{\"latitude\":45.464664,\"longitude\":9.188540}}}";
+
+static const char *documentUpdate =
+  "{\"update_id\":903,\"message\":{\"message_id\":79,\"from\":{\"id\":123456789,\"is_bot\":false,"
+  "\"first_name\":\"Mario\"},\"chat\":{\"id\":123456789,\"type\":\"private\"},\"date\":1700000300,"
+  "\"document\":{\"file_name\":\"firmware.bin\",\"mime_type\":\"application/octet-stream\","
+  "\"file_id\":\"BQACAgQAAxkBAAIBY2VmZ2hpamtsbW5vcHFyc3R1dnd4eXo\",\"file_unique_id\":\"AgADYwEAAm\","
+  "\"file_size\":1048576},\"caption\":\"OTA update \\ud83d\\ude80\"}}";
+
+static std::string reply(const std::vector<std::string> &updates)
+{
+  std::string json = "{\"ok\":true,\"result\":[";
+  for (size_t i = 0; i < updates.size(); i++)
+    json += (i ? "," : "") + updates[i];
+  return json + "]}";
+}
+
+typedef size_t (*Decoder)(const std::string &, TBCompactMessage *, size_t, MessageArena &);
+
+static void bench(const char *name, Decoder decoder, const std::string &json, size_t expected)
+{
+  TBCompactMessage queue[8];
+  const int iterations = 20000;
+
+  // Peak heap of first decoding, with a new strings arena
+  size_t peak;
+  {
+    MessageArena arena;
+    size_t baseline = heapUsed;
+    heapPeak = heapUsed;
+    if (decoder(json, queue, 8, arena) != expected) {
+      printf("%-20s decoding failed\n", name);
+      return;
+    }
+    // The arena uses realloc() directly, and it never shrinks
+    peak = heapPeak - baseline + arena.capacity();
+  }
+
+  // Time and heap allocations when the arena is reused (as in the library queue)
+  MessageArena arena;
+  decoder(json, queue, 8, arena);
+  size_t allocations = heapAllocations;
+  using namespace std::chrono;
+  steady_clock::time_point start = steady_clock::now();
+  for (int i = 0; i < iterations; i++)
+    decoder(json, queue, 8, arena);
+  double us = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0 / iterations;
+  double allocs = (double)(heapAllocations - allocations) / iterations;
+  printf("%-20s %10.2f us %10zu bytes %8.1f\n", name, us, peak, allocs);
+}
+
+int main()
+{
+  initFilter();
+
+  std::string longText;
+  for (int i = 0; i < 60; i++)
+    longText += "Lorem ipsum dolor sit amet, consectetur adipiscing elit. \\u00e8 ";
+
+  struct {
+    const char *name;
+    std::string json;
+    size_t updates;
+  } samples[] = {
+    { "single text", reply({ textUpdate(900, "/start hello") }), 1 },
+    { "long text", reply({ textUpdate(900, longText) }), 1 },
+    { "mixed batch of 8", reply({ textUpdate(900, "/start"), callbackUpdate, locationUpdate, documentUpdate,
+                                  textUpdate(904, "/status"), callbackUpdate, locationUpdate, documentUpdate }), 8 },
+  };
+
+  printf("UpdateParser object: %zu bytes (stack), TBCompactMessage: %zu bytes\n\n",
+         sizeof(UpdateParser), sizeof(TBCompactMessage));
+  for (auto &sample : samples) {
+    printf("%s (%zu bytes of JSON)\n", sample.name, sample.json.size());
+    printf("%-20s %13s %16s %8s\n", "", "time", "peak heap", "allocs");
+    bench("ArduinoJson", decodeWithArduinoJson, sample.json, sample.updates);
+    bench("UpdateParser", decodeWithParser, sample.json, sample.updates);
+    bench("UpdateParser stream", decodeWithParserStream, sample.json, sample.updates);
+    printf("\n");
+  }
+  return 0;
+}